@@ -5,6 +5,7 @@
 #include <string.h>
 #include <errno.h>
 #include <err.h>
+#include <dirent.h>
 
 /*
  * ls - list files.
@@ -78,6 +79,63 @@ isdir(const char *path)
 	return S_ISDIR(buf.st_mode);
 }
 
+/*
+ * Reading a directory. Entries are fetched a bufferful at a time with
+ * getdirentries() and handed out one by one.
+ */
+#define DIRBUFSIZE 1024
+
+struct dirreader {
+	const char *path;	/* for error messages */
+	int fd;
+	off_t cookie;		/* where the next getdirentries starts */
+	int pos, len;		/* next entry and amount of data in buf */
+	u_int32_t buf[DIRBUFSIZE/sizeof(u_int32_t)];	/* aligned */
+};
+
+static
+void
+opendirreader(struct dirreader *dr, const char *path)
+{
+	dr->path = path;
+	dr->fd = open(path, O_RDONLY);
+	if (dr->fd<0) {
+		err(1, "%s", path);
+	}
+	dr->cookie = 0;
+	dr->pos = dr->len = 0;
+}
+
+/* Return the next entry, or NULL at the end of the directory. */
+static
+struct dirent *
+readdirreader(struct dirreader *dr)
+{
+	struct dirent *d;
+
+	if (dr->pos >= dr->len) {
+		dr->len = getdirentries(dr->fd, dr->buf, sizeof(dr->buf),
+					&dr->cookie);
+		if (dr->len<0) {
+			err(1, "%s: getdirentries", dr->path);
+		}
+		if (dr->len==0) {
+			return NULL;
+		}
+		dr->pos = 0;
+	}
+	d = (struct dirent *)((char *)dr->buf + dr->pos);
+	dr->pos += d->d_reclen;
+	return d;
+}
+
+static
+void
+closedirreader(struct dirreader *dr)
+{
+	close(dr->fd);
+}
+
 /*
  * When listing one of several subdirectories, show the name of the
  * directory.
@@ -163,10 +221,9 @@ static
 void
 listdir(const char *path, int showheader)
 {
-	int fd;
-	char buf[1024];
+	struct dirreader dr;
+	struct dirent *d;
 	char newpath[1024];
-	int len;
 
 	if (showheader) {
 		printheader(path);
@@ -175,70 +232,62 @@ listdir(const char *path, int showheader)
 	/*
 	 * Open it.
 	 */
-	fd = open(path, O_RDONLY);
-	if (fd<0) {
-		err(1, "%s", path);
-	}
+	opendirreader(&dr, path);
 
 	/*
 	 * List the directory.
 	 */
-	while ((len = getdirentry(fd, buf, sizeof(buf)-1)) > 0) {
-		buf[len] = 0;
-
+	while ((d = readdirreader(&dr)) != NULL) {
 		/* Assemble the full name of the new item */
-		snprintf(newpath, sizeof(newpath), "%s/%s", path, buf);
+		snprintf(newpath, sizeof(newpath), "%s/%s", path, d->d_name);
 
-		if (aopt || buf[0]!='.') {
+		if (aopt || d->d_name[0]!='.') {
 			/* Print it */
 			print(newpath);
 		}
 	}
-	if (len<0) {
-		err(1, "%s: getdirentry", path);
-	}
 
 	/* Done */
-	close(fd);
+	closedirreader(&dr);
 }
 
 static
 void
 recursedir(const char *path)
 {
-	int fd;
-	char buf[1024];
+	struct dirreader dr;
+	struct dirent *d;
 	char newpath[1024];
-	int len;
 
 	/*
 	 * Open it.
 	 */
-	fd = open(path, O_RDONLY);
-	if (fd<0) {
-		err(1, "%s", path);
-	}
+	opendirreader(&dr, path);
 
 	/*
 	 * List the directory.
 	 */
-	while ((len = getdirentry(fd, buf, sizeof(buf)-1)) > 0) {
-		buf[len] = 0;
-
+	while ((d = readdirreader(&dr)) != NULL) {
 		/* Assemble the full name of the new item */
-		snprintf(newpath, sizeof(newpath), "%s/%s", path, buf);
+		snprintf(newpath, sizeof(newpath), "%s/%s", path, d->d_name);
 
-		if (!aopt && buf[0]=='.') {
+		if (!aopt && d->d_name[0]=='.') {
 			/* skip this one */
 			continue;
 		}
 
-		if (!strcmp(buf, ".") || !strcmp(buf, "..")) {
+		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, "..")) {
 			/* always skip these */
 			continue;
 		}
 
-		if (!isdir(newpath)) {
+		/* Only stat it if the filesystem didn't tell us the type */
+		if (d->d_type == DT_UNKNOWN) {
+			if (!isdir(newpath)) {
+				continue;
+			}
+		}
+		else if (d->d_type != DT_DIR) {
 			continue;
 		}
 
@@ -247,11 +296,8 @@ recursedir(const char *path)
 			recursedir(newpath);
 		}
 	}
-	if (len<0) {
-		err(1, "%s", path);
-	}
 
-	close(fd);
+	closedirreader(&dr);
 }
 
 static
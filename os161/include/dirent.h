@@ -0,0 +1,18 @@
+#ifndef _DIRENT_H_
+#define _DIRENT_H_
+
+/*
+ * Get struct dirent and the DT_* constants from the kernel.
+ */
+#include <sys/types.h>
+#include <kern/dirent.h>
+
+/*
+ * Read as many directory entries as fit in BUF, starting at *COOKIE
+ * (0 for the beginning of the directory). Updates *COOKIE to where
+ * the next call should continue. Returns the number of bytes used,
+ * 0 at the end of the directory, or -1 on error.
+ */
+int getdirentries(int filehandle, void *buf, size_t buflen, off_t *cookie);
+
+#endif /* _DIRENT_H_ */
@@ -0,0 +1,17 @@
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Get struct pollfd and the POLL* constants from the kernel.
+ */
+#include <kern/poll.h>
+
+/*
+ * Wait until one of the NFDS descriptors in FDS is ready for one of
+ * its events, or TIMEOUT milliseconds go by. A negative timeout waits
+ * forever; 0 returns at once. Returns the number of descriptors with
+ * nonzero revents, 0 on timeout, or -1 on error.
+ */
+int poll(struct pollfd *fds, int nfds, int timeout);
+
+#endif /* _POLL_H_ */
@@ -18,6 +18,7 @@ char *strtok(char *, const char *);
 void *memset(void *, int c, size_t);
 void *memcpy(void *, const void *, size_t);
 void *memmove(void *, const void *, size_t);
+int memcmp(const void *, const void *, size_t);
 
 /*
  * POSIX string functions.
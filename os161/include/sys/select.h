@@ -0,0 +1,35 @@
+#ifndef _SYS_SELECT_H_
+#define _SYS_SELECT_H_
+
+/*
+ * select(), for programs that want it rather than poll(). It is
+ * implemented in libc on top of poll.
+ */
+
+#include <sys/types.h>
+#include <kern/limits.h>
+#include <kern/time.h>
+
+/* One bit per descriptor; OPEN_MAX of them fit in one word. */
+#define FD_SETSIZE  OPEN_MAX
+
+typedef struct {
+	u_int32_t fds_bits;
+} fd_set;
+
+#define FD_ZERO(set)      ((set)->fds_bits = 0)
+#define FD_SET(fd, set)   ((set)->fds_bits |= (1U << (fd)))
+#define FD_CLR(fd, set)   ((set)->fds_bits &= ~(1U << (fd)))
+#define FD_ISSET(fd, set) (((set)->fds_bits & (1U << (fd))) != 0)
+
+/*
+ * Wait until a descriptor in READFDS is readable or one in WRITEFDS
+ * is writable, or TIMEOUT runs out (NULL waits forever). Descriptors
+ * below NFDS are looked at. On return the sets (those not NULL) hold
+ * only the ready descriptors; EXCEPTFDS is always cleared. Returns
+ * the number of bits set, 0 on timeout, or -1 on error.
+ */
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+	   struct timeval *timeout);
+
+#endif /* _SYS_SELECT_H_ */
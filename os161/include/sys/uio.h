@@ -0,0 +1,18 @@
+#ifndef _SYS_UIO_H_
+#define _SYS_UIO_H_
+
+#include <sys/types.h>
+
+/*
+ * Buffer descriptor for readv and writev. At most IOV_MAX (see
+ * limits.h) may be passed in one call.
+ */
+struct iovec {
+	void *iov_base;		/* start of buffer */
+	size_t iov_len;		/* length of buffer */
+};
+
+int readv(int filehandle, const struct iovec *iov, int iovcnt);
+int writev(int filehandle, const struct iovec *iov, int iovcnt);
+
+#endif /* _SYS_UIO_H_ */
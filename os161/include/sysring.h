@@ -0,0 +1,62 @@
+#ifndef _SYSRING_H_
+#define _SYSRING_H_
+
+/*
+ * System call batching. Queue up reads, writes, opens and closes on a
+ * ring and have the kernel run the lot in a single system call.
+ *
+ * The ring itself and the constants come from the kernel; see
+ * <kern/sysring.h>. A ring is a plain structure in the program's own
+ * memory (a global or a malloc'd block), set up with sysring_init.
+ *
+ * Typical use:
+ *
+ *     struct sysring_sqe *sqe;
+ *     struct sysring_cqe *cqe;
+ *
+ *     while (... && (sqe = sysring_get_sqe(&ring)) != NULL) {
+ *         sysring_prep_write(sqe, fd, buf, len);
+ *     }
+ *     sysring_submit(&ring);
+ *     while ((cqe = sysring_peek_cqe(&ring)) != NULL) {
+ *         ... look at cqe->result and cqe->error ...
+ *         sysring_cqe_seen(&ring);
+ *     }
+ */
+
+#include <sys/types.h>
+#include <kern/sysring.h>
+
+/* The system call proper. Returns the number of requests run. */
+int sysring_enter(struct sysring *ring);
+
+void sysring_init(struct sysring *ring);
+
+/* Next free submission entry, or NULL if the queue is full. */
+struct sysring_sqe *sysring_get_sqe(struct sysring *ring);
+
+/* Fill in a submission entry. */
+void sysring_prep_read(struct sysring_sqe *sqe, int fd, void *buf, size_t len);
+void sysring_prep_write(struct sysring_sqe *sqe, int fd, const void *buf,
+			size_t len);
+void sysring_prep_pread(struct sysring_sqe *sqe, int fd, void *buf, size_t len,
+			off_t off);
+void sysring_prep_pwrite(struct sysring_sqe *sqe, int fd, const void *buf,
+			 size_t len, off_t off);
+void sysring_prep_open(struct sysring_sqe *sqe, const char *path, int flags);
+void sysring_prep_close(struct sysring_sqe *sqe, int fd);
+
+/*
+ * Hand everything queued to the kernel. Keeps calling sysring_enter
+ * as long as it makes progress. Returns the number of requests run, or
+ * -1 on error.
+ */
+int sysring_submit(struct sysring *ring);
+
+/* Oldest unread completion, or NULL if there isn't one. */
+struct sysring_cqe *sysring_peek_cqe(struct sysring *ring);
+
+/* Done with the completion sysring_peek_cqe returned. */
+void sysring_cqe_seen(struct sysring *ring);
+
+#endif /* _SYSRING_H_ */
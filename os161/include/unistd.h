@@ -10,6 +10,7 @@
  */
 #include <kern/unistd.h>
 #include <kern/ioctl.h>
+#include <kern/time.h>
 
 
 /*
@@ -122,12 +123,16 @@ time_t __time(time_t *seconds, unsigned long *nanoseconds);
 int __getcwd(char *buf, size_t buflen);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
+int nanosleep(const struct timespec *req, struct timespec *rem);
+int pread(int filehandle, void *buf, size_t size, off_t pos);
+int pwrite(int filehandle, const void *buf, size_t size, off_t pos);
+int copy_file_range(int fromhandle, int tohandle, size_t size);
 
 /*
  * These are not themselves system calls, but wrapper routines in libc.
  */
 
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
-time_t time(time_t *seconds);			/* calls __time */
+time_t time(time_t *seconds);			/* reads the clock page */
 
 #endif /* _UNISTD_H_ */
@@ -10,6 +10,7 @@
 #include <vnode.h>
 #include <thread.h>
 #include <curthread.h>
+#include <clock.h>
 
 
 /*
@@ -42,6 +43,13 @@
  * there should be no need to fetch additional arguments from the
  * user-level stack.
  *
+ * Calls are dispatched through syscalltab, which is indexed by call
+ * number and gives the name of each call and a small function that
+ * pulls its arguments out of the trapframe. Every call is counted,
+ * along with how many failed and a histogram of how long they took
+ * (in powers of two of microseconds). The menu's "sc" command prints
+ * these.
+ *
  * Watch out: if you make system calls that have 64-bit quantities as
  * arguments, they will get passed in pairs of registers, and not
  * necessarily in the way you expect. We recommend you don't do it.
@@ -49,12 +57,343 @@
  * arch/mips/include/types.h.)
  */
 
+/*
+ * Argument marshalling: one of these per system call.
+ */
+
+static int sc_reboot(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_reboot(tf->tf_a0);
+}
+
+static int sc_exit(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys__exit(tf->tf_a0);
+}
+
+static int sc_execv(struct trapframe *tf, int32_t *retval)
+{
+	return sys_execv((const char *) tf->tf_a0, (char **) tf->tf_a1, retval);
+}
+
+static int sc_fork(struct trapframe *tf, int32_t *retval)
+{
+	return sys_fork(tf, retval);
+}
+
+static int sc_waitpid(struct trapframe *tf, int32_t *retval)
+{
+	return sys_waitpid(tf->tf_a0, (int *) tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_read(struct trapframe *tf, int32_t *retval)
+{
+	return sys_read(tf->tf_a0, (userptr_t *) tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_write(struct trapframe *tf, int32_t *retval)
+{
+	return sys_print(tf->tf_a0, (userptr_t *) tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_pread(struct trapframe *tf, int32_t *retval)
+{
+	return sys_pread(tf->tf_a0, (userptr_t *) tf->tf_a1, tf->tf_a2, tf->tf_a3, retval);
+}
+
+static int sc_pwrite(struct trapframe *tf, int32_t *retval)
+{
+	return sys_pwrite(tf->tf_a0, (userptr_t *) tf->tf_a1, tf->tf_a2, tf->tf_a3, retval);
+}
+
+static int sc_readv(struct trapframe *tf, int32_t *retval)
+{
+	return sys_readv(tf->tf_a0, (const struct iovec *) tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_writev(struct trapframe *tf, int32_t *retval)
+{
+	return sys_writev(tf->tf_a0, (const struct iovec *) tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_open(struct trapframe *tf, int32_t *retval)
+{
+	return sys_open((const char *) tf->tf_a0, tf->tf_a1, retval);
+}
+
+static int sc_close(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_close(tf->tf_a0);
+}
+
+static int sc_fsync(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_fsync(tf->tf_a0);
+}
+
+static int sc_lseek(struct trapframe *tf, int32_t *retval)
+{
+	return sys_lseek(tf->tf_a0, tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_dup2(struct trapframe *tf, int32_t *retval)
+{
+	return sys_dup2(tf->tf_a0, tf->tf_a1, retval);
+}
+
+static int sc_poll(struct trapframe *tf, int32_t *retval)
+{
+	return sys_poll((struct pollfd *) tf->tf_a0, tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_getdirentry(struct trapframe *tf, int32_t *retval)
+{
+	return sys_getdirentry(tf->tf_a0, (userptr_t *) tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_getdirentries(struct trapframe *tf, int32_t *retval)
+{
+	return sys_getdirentries(tf->tf_a0, (userptr_t *) tf->tf_a1, tf->tf_a2, (off_t *) tf->tf_a3, retval);
+}
+
+static int sc_pipe(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_pipe((int *) tf->tf_a0);
+}
+
+static int sc_copy_file_range(struct trapframe *tf, int32_t *retval)
+{
+	return sys_copy_file_range(tf->tf_a0, tf->tf_a1, tf->tf_a2, retval);
+}
+
+static int sc_remove(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_remove((const char *) tf->tf_a0);
+}
+
+static int sc_rename(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_rename((const char *) tf->tf_a0, (const char *) tf->tf_a1);
+}
+
+static int sc_getpid(struct trapframe *tf, int32_t *retval)
+{
+	(void)tf;
+	return sys_getpid(retval);
+}
+
+static int sc_sbrk(struct trapframe *tf, int32_t *retval)
+{
+	return sys_sbrk((intptr_t) tf->tf_a0, retval);
+}
+
+static int sc_nanosleep(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_nanosleep((const struct timespec *) tf->tf_a0,
+			     (struct timespec *) tf->tf_a1);
+}
+
+static int sc___time(struct trapframe *tf, int32_t *retval)
+{
+	return sys___time((time_t *) tf->tf_a0, (unsigned long *) tf->tf_a1, retval);
+}
+
+static int sc_sysring_enter(struct trapframe *tf, int32_t *retval)
+{
+	return sys_sysring_enter((struct sysring *) tf->tf_a0, retval);
+}
+
+struct syscall_entry {
+	const char *name;
+	int (*handler)(struct trapframe *tf, int32_t *retval);
+};
+
+static const struct syscall_entry syscalltab[] = {
+	[SYS__exit]		= { "_exit",		sc_exit },
+	[SYS_execv]		= { "execv",		sc_execv },
+	[SYS_fork]		= { "fork",		sc_fork },
+	[SYS_waitpid]		= { "waitpid",		sc_waitpid },
+	[SYS_open]		= { "open",		sc_open },
+	[SYS_read]		= { "read",		sc_read },
+	[SYS_write]		= { "write",		sc_write },
+	[SYS_close]		= { "close",		sc_close },
+	[SYS_reboot]		= { "reboot",		sc_reboot },
+	[SYS_sbrk]		= { "sbrk",		sc_sbrk },
+	[SYS_getpid]		= { "getpid",		sc_getpid },
+	[SYS_lseek]		= { "lseek",		sc_lseek },
+	[SYS_fsync]		= { "fsync",		sc_fsync },
+	[SYS_remove]		= { "remove",		sc_remove },
+	[SYS_rename]		= { "rename",		sc_rename },
+	[SYS_dup2]		= { "dup2",		sc_dup2 },
+	[SYS_getdirentry]	= { "getdirentry",	sc_getdirentry },
+	[SYS_pipe]		= { "pipe",		sc_pipe },
+	[SYS___time]		= { "__time",		sc___time },
+	[SYS_nanosleep]		= { "nanosleep",	sc_nanosleep },
+	[SYS_readv]		= { "readv",		sc_readv },
+	[SYS_writev]		= { "writev",		sc_writev },
+	[SYS_pread]		= { "pread",		sc_pread },
+	[SYS_pwrite]		= { "pwrite",		sc_pwrite },
+	[SYS_copy_file_range]	= { "copy_file_range",	sc_copy_file_range },
+	[SYS_sysring_enter]	= { "sysring_enter",	sc_sysring_enter },
+	[SYS_getdirentries]	= { "getdirentries",	sc_getdirentries },
+	[SYS_poll]		= { "poll",		sc_poll },
+};
+
+#define NSYSCALLS  ((int)(sizeof(syscalltab) / sizeof(syscalltab[0])))
+
+/*
+ * Per-call statistics. Bucket 0 of the histogram counts calls that
+ * took under 1 microsecond; bucket i counts calls that took from
+ * 2^(i-1) up to 2^i microseconds; the last bucket takes everything
+ * longer.
+ *
+ * The total time is kept as seconds plus microseconds, because a
+ * 32-bit count of microseconds wraps after about 71 minutes, and one
+ * blocking call (read, waitpid) can take longer than that.
+ */
+#define SYSCALL_NBUCKETS  24
+
+/* Most whole seconds whose microseconds fit in a u_int32_t */
+#define SYSCALL_MAXSECS  ((0xffffffffU - 999999) / 1000000)
+
+struct syscall_stats {
+	u_int32_t calls;
+	u_int32_t errors;
+	u_int32_t secs;			/* total time, for the average */
+	u_int32_t usecs;		/* (less than 1000000) */
+	u_int32_t hist[SYSCALL_NBUCKETS];
+};
+
+static struct syscall_stats syscallstats[NSYSCALLS];
+static u_int32_t syscall_unknown;
+
+/*
+ * Record one call of CALLNO that took from time 1 to time 2.
+ */
+static
+void
+syscall_account(int callno, int err,
+		time_t secs1, u_int32_t nsecs1, time_t secs2, u_int32_t nsecs2)
+{
+	struct syscall_stats *st = &syscallstats[callno];
+	time_t secs;
+	u_int32_t nsecs, usecs;
+	int bucket, spl;
+
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs, &nsecs);
+	if (secs > SYSCALL_MAXSECS) {
+		/* Off the scale; goes in the last bucket */
+		usecs = 0xffffffff;
+	}
+	else {
+		usecs = secs * 1000000 + nsecs / 1000;
+	}
+
+	for (bucket = 0; usecs >> bucket != 0 && bucket < SYSCALL_NBUCKETS-1;
+	     bucket++) {
+		/* nothing */
+	}
+
+	spl = splhigh();
+	if (err) {
+		st->errors++;
+	}
+	st->secs += secs;
+	st->usecs += nsecs / 1000;
+	if (st->usecs >= 1000000) {
+		st->secs++;
+		st->usecs -= 1000000;
+	}
+	st->hist[bucket]++;
+	splx(spl);
+}
+
+void
+syscall_printstats(void)
+{
+	struct syscall_stats st;
+	int i, b, spl;
+
+	kprintf("%-16s %10s %10s %10s\n", "syscall", "calls", "errors",
+		"avg usecs");
+	for (i=0; i<NSYSCALLS; i++) {
+		if (syscalltab[i].name == NULL) {
+			continue;
+		}
+
+		spl = splhigh();
+		st = syscallstats[i];
+		splx(spl);
+
+		if (st.calls == 0) {
+			continue;
+		}
+
+		/*
+		 * Calls that don't return (_exit, execv) have no time.
+		 * If the total is too big to count in microseconds,
+		 * the average is shown in whole seconds.
+		 */
+		if (st.secs <= SYSCALL_MAXSECS) {
+			kprintf("%-16s %10u %10u %10u\n", syscalltab[i].name,
+				st.calls, st.errors,
+				(st.secs * 1000000 + st.usecs) / st.calls);
+		}
+		else {
+			kprintf("%-16s %10u %10u %9us\n", syscalltab[i].name,
+				st.calls, st.errors, st.secs / st.calls);
+		}
+
+		kprintf("   ");
+		for (b=0; b<SYSCALL_NBUCKETS; b++) {
+			if (st.hist[b] == 0) {
+				continue;
+			}
+			if (b == 0) {
+				kprintf(" <1us:%u", st.hist[b]);
+			}
+			else if (b == SYSCALL_NBUCKETS-1) {
+				kprintf(" >=%uus:%u", 1U << (b-1), st.hist[b]);
+			}
+			else {
+				kprintf(" <%uus:%u", 1U << b, st.hist[b]);
+			}
+		}
+		kprintf("\n");
+	}
+	if (syscall_unknown > 0) {
+		kprintf("%u calls to unknown system calls\n", syscall_unknown);
+	}
+}
+
+void
+syscall_resetstats(void)
+{
+	int spl;
+
+	spl = splhigh();
+	bzero(syscallstats, sizeof(syscallstats));
+	syscall_unknown = 0;
+	splx(spl);
+}
+
 void
 mips_syscall(struct trapframe *tf)
 {
 	int callno;
 	int32_t retval;
 	int err;
+	int spl;
+	time_t secs1, secs2;
+	u_int32_t nsecs1, nsecs2;
 
 	assert(curspl==0);
 
@@ -71,47 +410,28 @@ mips_syscall(struct trapframe *tf)
 
 	retval = 0;
 
-	switch (callno) {
-	    case SYS_reboot:
-		err = sys_reboot(tf->tf_a0);
-		break;
-
-		case SYS__exit:
-		err = sys__exit(tf->tf_a0);
-		break;
-
-	    case SYS_execv:
-	    err = sys_execv((userptr_t) tf->tf_a0, (userptr_t) tf->tf_a1, &retval);
-	    break;
-
-	    case SYS_fork:
-	    err = sys_fork(tf, &retval);
-	    break;
-
-	    case SYS_waitpid:
-	    err = sys_waitpid(tf->tf_a0, (userptr_t) tf->tf_a1, tf->tf_a2, &retval);
-	    break;
-
-	    case SYS_read:
-	    err = sys_read(tf->tf_a0, (userptr_t) tf->tf_a1, tf->tf_a2, &retval);
-	    break;
-
-	    case SYS_write:
-	    err = sys_print(tf->tf_a0, (userptr_t) tf->tf_a1, tf->tf_a2, &retval);
-	    break;
-
-	    case SYS_getpid:
-	    err = sys_getpid(&retval);
-	    break;
- 		
- 		case SYS_sbrk:
-		err = sys_sbrk((intptr_t)tf->tf_a0,&retval);
-		break;
-
-	    default:
+	if (callno < 0 || callno >= NSYSCALLS ||
+	    syscalltab[callno].handler == NULL) {
+		spl = splhigh();
+		syscall_unknown++;
+		splx(spl);
 		kprintf("Unknown syscall %d\n", callno);
 		err = ENOSYS;
-		break;
+	}
+	else {
+		/*
+		 * Count the call up front, since _exit and a successful
+		 * execv never come back here.
+		 */
+		spl = splhigh();
+		syscallstats[callno].calls++;
+		splx(spl);
+
+		gettime(&secs1, &nsecs1);
+		err = syscalltab[callno].handler(tf, &retval);
+		gettime(&secs2, &nsecs2);
+
+		syscall_account(callno, err, secs1, nsecs1, secs2, nsecs2);
 	}
 
 
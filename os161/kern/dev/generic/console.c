@@ -17,8 +17,8 @@
  * and (2) if the system crashes before we find a console, no output
  * at all may appear.
  *
- * Note that we have no input buffering; characters typed too rapidly
- * will be lost.
+ * Input is buffered, up to CON_INBUFSIZE characters; beyond that,
+ * characters typed too rapidly will be lost.
  */
 
 #include <types.h>
@@ -30,6 +30,8 @@
 #include <dev.h>
 #include <vfs.h>
 #include <uio.h>
+#include <poll.h>
+#include <kern/poll.h>
 #include "autoconf.h"
 
 /*
@@ -114,8 +116,18 @@ static
 int
 getch_intr(struct con_softc *cs)
 {
+	int ch, s;
+
 	P(cs->cs_rsem);
-	return cs->cs_gotchar;
+
+	s = splhigh();
+	assert(cs->cs_incount > 0);
+	ch = cs->cs_inbuf[cs->cs_inhead];
+	cs->cs_inhead = (cs->cs_inhead + 1) % CON_INBUFSIZE;
+	cs->cs_incount--;
+	splx(s);
+
+	return ch;
 }
 
 /*
@@ -125,9 +137,18 @@ void
 con_input(void *vcs, int ch)
 {
 	struct con_softc *cs = vcs;
+	unsigned tail;
+
+	if (cs->cs_incount == CON_INBUFSIZE) {
+		/* No room; drop it */
+		return;
+	}
 
-	cs->cs_gotchar = ch;
+	tail = (cs->cs_inhead + cs->cs_incount) % CON_INBUFSIZE;
+	cs->cs_inbuf[tail] = ch;
+	cs->cs_incount++;
 	V(cs->cs_rsem);
+	poll_wakeup();
 }
 
 /*
@@ -206,6 +227,8 @@ con_io(struct device *dev, struct uio *uio)
 {
 	int result;
 	char ch;
+	char buf[64];
+	size_t len, i;
 	struct lock *lk;
 
 	(void)dev;  // unused
@@ -236,15 +259,25 @@ con_io(struct device *dev, struct uio *uio)
 			}
 		}
 		else {
-			result = uiomove(&ch, 1, uio);
+			/*
+			 * Pull over a chunk at a time, rather than
+			 * calling uiomove for every character.
+			 */
+			len = uio->uio_resid;
+			if (len > sizeof(buf)) {
+				len = sizeof(buf);
+			}
+			result = uiomove(buf, len, uio);
 			if (result) {
 				lock_release(lk);
 				return result;
 			}
-			if (ch=='\n') {
-				putch('\r');
+			for (i=0; i<len; i++) {
+				if (buf[i]=='\n') {
+					putch('\r');
+				}
+				putch(buf[i]);
 			}
-			putch(ch);
 		}
 	}
 	lock_release(lk);
@@ -262,6 +295,23 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * Input is ready if anything has been typed; output never waits for
+ * long, so call it always ready.
+ */
+static
+int
+con_poll(struct device *dev, int events)
+{
+	struct con_softc *cs = dev->d_data;
+	int revents = events & POLLOUT;
+
+	if (cs->cs_incount > 0) {
+		revents |= events & POLLIN;
+	}
+	return revents;
+}
+
 static
 int
 attach_console_to_vfs(struct con_softc *cs)
@@ -278,6 +328,7 @@ attach_console_to_vfs(struct con_softc *cs)
 	dev->d_close = con_close;
 	dev->d_io = con_io;
 	dev->d_ioctl = con_ioctl;
+	dev->d_poll = con_poll;
 	dev->d_blocks = 0;
 	dev->d_blocksize = 1;
 	dev->d_data = cs;
@@ -341,7 +392,8 @@ config_con(struct con_softc *cs, int unit)
 
 	cs->cs_rsem = rsem; 
 	cs->cs_wsem = wsem; 
-	cs->cs_gotchar = 0;
+	cs->cs_inhead = 0;
+	cs->cs_incount = 0;
 
 	the_console = cs;
 	con_userlock_read = rlk;
@@ -6,8 +6,13 @@
  *
  * devdata, send, and sendpolled are provided by the underlying
  * device, and are to be initialized by the attach routine.
+ *
+ * Characters typed are kept in cs_inbuf until read; cs_rsem counts
+ * them. Anything typed while the buffer is full is lost.
  */
 
+#define CON_INBUFSIZE  64
+
 struct con_softc {
 	/* initialized by attach routine */
 	void *cs_devdata;
@@ -17,7 +22,9 @@ struct con_softc {
 	/* initialized by config routine */
 	struct semaphore *cs_rsem;
 	struct semaphore *cs_wsem;
-	int cs_gotchar;
+	char cs_inbuf[CON_INBUFSIZE];
+	unsigned cs_inhead;		/* next character to read */
+	unsigned cs_incount;		/* characters in cs_inbuf */
 };
 
 /*
@@ -15,6 +15,7 @@
 #include <kern/errno.h>
 #include <kern/unistd.h>
 #include <kern/stat.h>
+#include <kern/dirent.h>
 #include <lib.h>
 #include <synch.h>
 #include <array.h>
@@ -538,6 +539,71 @@ emufs_getdirentry(struct vnode *v, struct uio *uio)
 	return emu_readdir(ev->ev_emu, ev->ev_handle, amt, uio);
 }
 
+/*
+ * VOP_GETDIRENTRIES
+ *
+ * The emulator only hands out one name at a time, so fetch them one
+ * by one and pack them up. Inode numbers and types aren't available.
+ */
+static
+int
+emufs_getdirentries(struct vnode *v, struct uio *uio)
+{
+	struct emufs_vnode *ev = v->vn_data;
+	struct dirent *d;
+	struct uio ku;
+	off_t pos;
+	size_t namelen, reclen;
+	int result, count = 0;
+
+	assert(uio->uio_rw==UIO_READ);
+
+	d = kmalloc(sizeof(struct dirent));
+	if (d == NULL) {
+		return ENOMEM;
+	}
+
+	pos = uio->uio_offset;
+	while (1) {
+		mk_kuio(&ku, d->d_name, NAME_MAX, pos, UIO_READ);
+		result = emu_readdir(ev->ev_emu, ev->ev_handle, NAME_MAX, &ku);
+		if (result) {
+			break;
+		}
+
+		namelen = NAME_MAX - ku.uio_resid;
+		if (namelen == 0) {
+			/* end of directory */
+			break;
+		}
+
+		reclen = DIRENT_RECLEN(namelen);
+		if (reclen > uio->uio_resid) {
+			if (count == 0) {
+				result = EINVAL;
+			}
+			break;
+		}
+
+		bzero(d->d_name + namelen, reclen - DIRENT_HDRSIZE - namelen);
+		d->d_ino = 0;
+		d->d_reclen = reclen;
+		d->d_type = DT_UNKNOWN;
+		d->d_namlen = namelen;
+
+		result = uiomove(d, reclen, uio);
+		if (result) {
+			break;
+		}
+		pos = ku.uio_offset;
+		count++;
+	}
+
+	kfree(d);
+	uio->uio_offset = pos;
+	return result;
+}
+
 /*
  * VOP_WRITE
  */
@@ -645,6 +711,18 @@ emufs_dir_gettype(struct vnode *v, u_int32_t *result)
 	return 0;
 }
 
+/*
+ * VOP_POLL
+ */
+static
+int
+emufs_poll(struct vnode *v, int events, int *revents)
+{
+	(void)v;
+	*revents = events;
+	return 0;
+}
+
 /*
  * VOP_TRYSEEK
  */
@@ -847,10 +925,12 @@ static const struct vnode_ops emufs_fileops = {
 	emufs_read,
 	NOTDIR,  /* readlink */
 	NOTDIR,  /* getdirentry */
+	NOTDIR,  /* getdirentries */
 	emufs_write,
 	emufs_ioctl,
 	emufs_stat,
 	emufs_file_gettype,
+	emufs_poll,
 	emufs_tryseek,
 	emufs_fsync,
 	UNIMP,   /* mmap */
@@ -882,10 +962,12 @@ static const struct vnode_ops emufs_dirops = {
 	ISDIR,   /* read */
 	ISDIR,   /* readlink */
 	emufs_getdirentry,
+	emufs_getdirentries,
 	ISDIR,   /* write */
 	emufs_ioctl,
 	emufs_stat,
 	emufs_dir_gettype,
+	emufs_poll,
 	UNIMP,   /* tryseek */
 	ISDIR,   /* fsync */
 	ISDIR,   /* mmap */
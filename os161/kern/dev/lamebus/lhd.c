@@ -1,10 +1,20 @@
 /*
  * LAMEbus hard disk (lhd) driver.
+ *
+ * Requests wait in a queue sorted by sector and are served one at a
+ * time in C-LOOK order: the next request is the first one at or past
+ * where the disk head is, wrapping around to the lowest sector when
+ * there is nothing further along. The thread that made a request does
+ * its transfer (the data has to move in that thread's context, as it
+ * may be in user space), and when done hands the disk to the next
+ * request. The queue and the current request are protected with
+ * splhigh, as the interrupt handler looks at them.
  */
 
 #include <types.h>
 #include <lib.h>
-#include <synch.h>
+#include <machine/spl.h>
+#include <thread.h>
 #include <kern/errno.h>
 #include <machine/bus.h>
 #include <uio.h>
@@ -30,6 +40,19 @@
 /* Buffer (offset within slot)  */
 #define LHD_BUFFER      32768
 
+/*
+ * A request for I/O, from lhd_io. Lives on the requesting thread's
+ * stack.
+ */
+struct lhd_request {
+	struct uio *lr_uio;		/* where the data goes */
+	u_int32_t lr_sector;		/* first sector */
+	u_int32_t lr_nsect;		/* number of sectors */
+	volatile int lr_sectdone;	/* current sector finished */
+	int lr_result;			/* ...with this result */
+	struct lhd_request *lr_next;	/* queue, sorted by lr_sector */
+};
+
 /*
  * Shortcut for reading a register.
  */
@@ -66,15 +89,22 @@ int lhd_code_to_errno(struct lhd_softc *lh, int code)
 }
 
 /*
- * Record that an I/O has completed: save the result and poke the
- * completion semaphore.
+ * Record that an I/O has completed: save the result in the current
+ * request and wake up the thread doing it.
  */
 static
 void
 lhd_iodone(struct lhd_softc *lh, int err)
 {
-	lh->lh_result = err;
-	V(lh->lh_done);
+	struct lhd_request *req = lh->lh_active;
+
+	if (req == NULL) {
+		kprintf("lhd%d: Completion with no request\n", lh->lh_unit);
+		return;
+	}
+	req->lr_result = err;
+	req->lr_sectdone = 1;
+	thread_wakeup(req);
 }
 
 /*
@@ -164,22 +194,132 @@ lhd_reset(struct lhd_softc *lh)
 }
 #endif
 
+/*
+ * Put a request in the queue, in sector order. Call at splhigh.
+ */
+static
+void
+lhd_enqueue(struct lhd_softc *lh, struct lhd_request *req)
+{
+	struct lhd_request **rp;
+
+	rp = &lh->lh_queue;
+	while (*rp != NULL && (*rp)->lr_sector <= req->lr_sector) {
+		rp = &(*rp)->lr_next;
+	}
+	req->lr_next = *rp;
+	*rp = req;
+}
+
+/*
+ * The current request is finished; give the disk to the next one, in
+ * C-LOOK order. A request that starts right where the last one ended
+ * comes next, so adjacent requests run back to back without a seek.
+ * Call at splhigh.
+ */
+static
+void
+lhd_dispatch(struct lhd_softc *lh)
+{
+	struct lhd_request **rp, *req;
+
+	/* First request at or past the head... */
+	rp = &lh->lh_queue;
+	while (*rp != NULL && (*rp)->lr_sector < lh->lh_head) {
+		rp = &(*rp)->lr_next;
+	}
+	/* ...or if none, wrap around to the lowest */
+	if (*rp == NULL) {
+		rp = &lh->lh_queue;
+	}
+
+	req = *rp;
+	if (req != NULL) {
+		*rp = req->lr_next;
+		req->lr_next = NULL;
+	}
+	lh->lh_active = req;
+	if (req != NULL) {
+		thread_wakeup(req);
+	}
+}
+
+/*
+ * Do one sector of the current request, which must be REQ.
+ */
+static
+int
+lhd_sectio(struct lhd_softc *lh, struct lhd_request *req, u_int32_t sector)
+{
+	struct uio *uio = req->lr_uio;
+	u_int32_t statval = LHD_WORKING;
+	int result, spl;
+
+	assert(lh->lh_active == req);
+
+	/*
+	 * Are we writing? If so, transfer the data to the
+	 * on-card buffer.
+	 */
+	if (uio->uio_rw == UIO_WRITE) {
+		result = uiomove(lh->lh_buf, LHD_SECTSIZE, uio);
+		if (result) {
+			return result;
+		}
+		statval |= LHD_ISWRITE;
+	}
+
+	spl = splhigh();
+
+	/* Tell it what sector we want... */
+	req->lr_sectdone = 0;
+	lhd_wreg(lh, LHD_REG_SECT, sector);
+
+	/* and start the operation. */
+	lhd_wreg(lh, LHD_REG_STAT, statval);
+
+	/* Now wait until the interrupt handler tells us we're done. */
+	while (!req->lr_sectdone) {
+		thread_sleep(req);
+	}
+
+	/* Get the result value saved by the interrupt handler. */
+	result = req->lr_result;
+
+	splx(spl);
+
+	/*
+	 * Are we reading? If so, and if we succeeded,
+	 * transfer the data out of the on-card buffer.
+	 */
+	if (result==0 && uio->uio_rw==UIO_READ) {
+		result = uiomove(lh->lh_buf, LHD_SECTSIZE, uio);
+	}
+
+	return result;
+}
+
 /*
  * I/O function (for both reads and writes)
+ *
+ * The card only holds one sector, so each sector is a separate
+ * operation with its own completion interrupt. A request keeps the
+ * disk from its first sector to its last, so nothing gets in between
+ * the sectors of a run.
  */
 static
 int
 lhd_io(struct device *d, struct uio *uio)
 {
 	struct lhd_softc *lh = d->d_data;
+	struct lhd_request req;
 
 	u_int32_t sector = uio->uio_offset / LHD_SECTSIZE;
 	u_int32_t sectoff = uio->uio_offset % LHD_SECTSIZE;
 	u_int32_t len = uio->uio_resid / LHD_SECTSIZE;
 	u_int32_t lenoff = uio->uio_resid % LHD_SECTSIZE;
 	u_int32_t i;
-	u_int32_t statval = LHD_WORKING;
-	int result;
+	int result, spl;
 
 	/* Don't allow I/O that isn't sector-aligned. */
 	if (sectoff != 0 || lenoff != 0) {
@@ -191,59 +331,44 @@ lhd_io(struct device *d, struct uio *uio)
 		return EINVAL;
 	}
 
-	/* Set up the value to write into the status register. */
-	if (uio->uio_rw==UIO_WRITE) {
-		statval |= LHD_ISWRITE;
+	if (len == 0) {
+		return 0;
 	}
 
-	/* Loop over all the sectors we were asked to do. */
-	for (i=0; i<len; i++) {
-
-		/* Wait until nobody else is using the device. */
-		P(lh->lh_clear);
-
-		/*
-		 * Are we writing? If so, transfer the data to the
-		 * on-card buffer.
-		 */
-		if (uio->uio_rw == UIO_WRITE) {
-			result = uiomove(lh->lh_buf, LHD_SECTSIZE, uio);
-			if (result) {
-				V(lh->lh_clear);
-				return result;
-			}
-		}
-
-		/* Tell it what sector we want... */
-		lhd_wreg(lh, LHD_REG_SECT, sector+i);
-
-		/* and start the operation. */
-		lhd_wreg(lh, LHD_REG_STAT, statval);
-
-		/* Now wait until the interrupt handler tells us we're done. */
-		P(lh->lh_done);
-
-		/* Get the result value saved by the interrupt handler. */
-		result = lh->lh_result;
-
-		/*
-		 * Are we reading? If so, and if we succeeded,
-		 * transfer the data out of the on-card buffer.
-		 */
-		if (result==0 && uio->uio_rw==UIO_READ) {
-			result = uiomove(lh->lh_buf, LHD_SECTSIZE, uio);
+	req.lr_uio = uio;
+	req.lr_sector = sector;
+	req.lr_nsect = len;
+	req.lr_sectdone = 0;
+	req.lr_result = 0;
+	req.lr_next = NULL;
+
+	/* Wait for our turn. */
+	spl = splhigh();
+	if (lh->lh_active == NULL) {
+		lh->lh_active = &req;
+	}
+	else {
+		lhd_enqueue(lh, &req);
+		while (lh->lh_active != &req) {
+			thread_sleep(&req);
 		}
+	}
+	splx(spl);
 
-		/* Tell another thread it's cleared to go ahead. */
-		V(lh->lh_clear);
-
-		/* If we failed, return the error. */
-		if (result) {
-			return result;
-		}
+	/* Loop over all the sectors we were asked to do. */
+	result = 0;
+	for (i=0; i<len && result==0; i++) {
+		result = lhd_sectio(lh, &req, sector+i);
 	}
 
-	return 0;
+	/* Hand the disk on; the head is now past our last sector. */
+	spl = splhigh();
+	lh->lh_head = sector + len;
+	lhd_dispatch(lh);
+	splx(spl);
+
+	/* If we failed, this is the error. */
+	return result;
 }
 
 /*
@@ -260,23 +385,17 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 	/* Get a pointer to the on-chip buffer. */
 	lh->lh_buf = bus_map_area(lh->lh_busdata, lh->lh_buspos, LHD_BUFFER);
 
-	/* Create the semaphores. */
-	lh->lh_clear = sem_create("lhd-clear", 1);
-	if (lh->lh_clear == NULL) {
-		return ENOMEM;
-	}
-	lh->lh_done = sem_create("lhd-done", 0);
-	if (lh->lh_done == NULL) {
-		sem_destroy(lh->lh_clear);
-		lh->lh_clear = NULL;
-		return ENOMEM;
-	}
+	/* Nothing going on yet. */
+	lh->lh_active = NULL;
+	lh->lh_queue = NULL;
+	lh->lh_head = 0;
 
 	/* Set up the VFS device structure. */
 	lh->lh_dev.d_open = lhd_open;
 	lh->lh_dev.d_close = lhd_close;
 	lh->lh_dev.d_io = lhd_io;
 	lh->lh_dev.d_ioctl = lhd_ioctl;
+	lh->lh_dev.d_poll = NULL;
 	lh->lh_dev.d_blocks = bus_read_register(lh->lh_busdata, lh->lh_buspos,
 						LHD_REG_NSECT);
 	lh->lh_dev.d_blocksize = LHD_SECTSIZE;
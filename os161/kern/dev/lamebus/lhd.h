@@ -3,6 +3,8 @@
 
 #include <dev.h>
 
+struct lhd_request;	/* Private to lhd.c */
+
 /*
  * Our sector size
  */
@@ -22,9 +24,9 @@ struct lhd_softc {
 	 */
 
 	void *lh_buf;			/* Pointer to on-card I/O buffer */
-	int lh_result;			/* Result from I/O operation */
-	struct semaphore *lh_clear;	/* Synchronization */
-	struct semaphore *lh_done;
+	struct lhd_request *lh_active;	/* Request using the disk */
+	struct lhd_request *lh_queue;	/* Waiting requests, by sector */
+	u_int32_t lh_head;		/* Sector after the last one done */
 
 	struct device lh_dev;		/* VFS device structure */
 };
@@ -46,6 +46,9 @@ config_ltimer(struct ltimer_softc *lt, int ltimerno)
 		bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_COUNT,
 				   LT_GRANULARITY/HZ);
 
+		/* Let hardclock slow us down when the system is idle. */
+		hardclock_register(lt, ltimer_settimer, ltimer_gettime);
+
 		kprintf("\nhardclock on ltimer%d (%u hz)", ltimerno, HZ);
 	}
 	else {
@@ -79,6 +82,19 @@ ltimer_irq(void *vlt)
 	}
 }
 
+/*
+ * Reprogram the countdown timer to go off every USECS microseconds.
+ * Writing the count register restarts the countdown. Used by hardclock
+ * to skip ticks while idle.
+ */
+void
+ltimer_settimer(void *vlt, u_int32_t usecs)
+{
+	struct ltimer_softc *lt = vlt;
+
+	bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_COUNT, usecs);
+}
+
 /*
  * The timer device will beep if you write to the beep register. It
  * doesn't matter what value you write. This function is called if
@@ -21,5 +21,7 @@ void ltimer_irq(/*struct ltimer_softc*/ void *lt);  // interrupt handler
 void ltimer_beep(/*struct ltimer_softc*/ void *devdata);   // for beep device
 void ltimer_gettime(/*struct ltimer_softc*/ void *devdata,
 		    time_t *secs, u_int32_t *nsecs);       // for rtclock
+void ltimer_settimer(/*struct ltimer_softc*/ void *devdata,
+		     u_int32_t usecs);                      // for hardclock
 
 #endif /* _LAMEBUS_LTIMER_H_ */
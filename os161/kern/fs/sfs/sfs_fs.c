@@ -7,12 +7,12 @@
 #include <types.h>
 #include <lib.h>
 #include <kern/errno.h>
-#include <array.h>
 #include <bitmap.h>
 #include <uio.h>
 #include <dev.h>
 #include <sfs.h>
 #include <vfs.h>
+#include <buf.h>
 
 /* Shortcuts for the size macros in kern/sfs.h */
 #define SFS_FS_BITMAPSIZE(sfs)  SFS_BITMAPSIZE((sfs)->sfs_super.sp_nblocks)
@@ -82,7 +82,8 @@ int
 sfs_sync(struct fs *fs)
 {
 	struct sfs_fs *sfs; 
-	int i, num, result;
+	struct sfs_vnode *sv;
+	int result;
 
 	/*
 	 * Get the sfs_fs from the generic abstract fs.
@@ -116,11 +117,16 @@ sfs_sync(struct fs *fs)
 
 	sfs = fs->fs_data;
 
-	/* Go over the array of loaded vnodes, syncing as we go. */
-	num = array_getnum(sfs->sfs_vnodes);
-	for (i=0; i<num; i++) {
-		struct sfs_vnode *sv = array_getguy(sfs->sfs_vnodes, i);
-		VOP_FSYNC(&sv->sv_v);
+	/*
+	 * Write the dirty inodes of the loaded vnodes into the buffer
+	 * cache. Syncing one takes it off the dirty list. (Not
+	 * VOP_FSYNC, which would write each file to disk on its own.)
+	 */
+	while ((sv = sfs->sfs_dirtyvnodes) != NULL) {
+		result = sfs_sync_inode(sv);
+		if (result) {
+			return result;
+		}
 	}
 
 	/* If the free block map needs to be written, write it. */
@@ -141,7 +147,8 @@ sfs_sync(struct fs *fs)
 		sfs->sfs_superdirty = 0;
 	}
 
-	return 0;
+	/* Everything above only reached the buffer cache; flush it. */
+	return buf_sync(sfs->sfs_device);
 }
 
 /*
@@ -167,9 +174,10 @@ int
 sfs_unmount(struct fs *fs)
 {
 	struct sfs_fs *sfs = fs->fs_data;
+	int result;
 	
 	/* Do we have any files open? If so, can't unmount. */
-	if (array_getnum(sfs->sfs_vnodes)>0) {
+	if (sfs->sfs_nvnodes>0) {
 		return EBUSY;
 	}
 
@@ -177,8 +185,13 @@ sfs_unmount(struct fs *fs)
 	assert(sfs->sfs_superdirty==0);
 	assert(sfs->sfs_freemapdirty==0);
 
+	/* Drop our blocks from the buffer cache. */
+	result = buf_purge(sfs->sfs_device);
+	if (result) {
+		return result;
+	}
+
 	/* Once we start nuking stuff we can't fail. */
-	array_destroy(sfs->sfs_vnodes);
 	bitmap_destroy(sfs->sfs_freemap);
 	
 	/* The vfs layer takes care of the device for us */
@@ -209,7 +222,7 @@ static
 int
 sfs_domount(void *options, struct device *dev, struct fs **ret)
 {
-	int result;
+	int i, result;
 	struct sfs_fs *sfs;
 
 	/* We don't pass any options through mount */
@@ -240,12 +253,12 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 		return ENOMEM;
 	}
 
-	/* Allocate array */
-	sfs->sfs_vnodes = array_create();
-	if (sfs->sfs_vnodes == NULL) {
-		kfree(sfs);
-		return ENOMEM;
+	/* No vnodes loaded yet */
+	for (i=0; i<SFS_VNHASHSIZE; i++) {
+		sfs->sfs_vnhash[i] = NULL;
 	}
+	sfs->sfs_nvnodes = 0;
+	sfs->sfs_dirtyvnodes = NULL;
 
 	/* Set the device so we can use sfs_rblock() */
 	sfs->sfs_device = dev;
@@ -253,7 +266,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	/* Load superblock */
 	result = sfs_rblock(sfs, &sfs->sfs_super, SFS_SB_LOCATION);
 	if (result) {
-		array_destroy(sfs->sfs_vnodes);
 		kfree(sfs);
 		return result;
 	}
@@ -265,11 +277,17 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 			"(0x%x, should be 0x%x)\n", 
 			sfs->sfs_super.sp_magic,
 			SFS_MAGIC);
-		array_destroy(sfs->sfs_vnodes);
 		kfree(sfs);
 		return EINVAL;
 	}
 	
+	if (sfs->sfs_super.sp_features & ~SFS_FEATURES_KNOWN) {
+		kprintf("sfs: Unsupported features 0x%x in superblock\n",
+			sfs->sfs_super.sp_features & ~SFS_FEATURES_KNOWN);
+		kfree(sfs);
+		return EINVAL;
+	}
+
 	if (sfs->sfs_super.sp_nblocks > dev->d_blocks) {
 		kprintf("sfs: warning - fs has %u blocks, device has %u\n",
 			sfs->sfs_super.sp_nblocks, dev->d_blocks);
@@ -281,14 +299,12 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	/* Load free space bitmap */
 	sfs->sfs_freemap = bitmap_create(SFS_FS_BITMAPSIZE(sfs));
 	if (sfs->sfs_freemap == NULL) {
-		array_destroy(sfs->sfs_vnodes);
 		kfree(sfs);
 		return ENOMEM;
 	}
 	result = sfs_mapio(sfs, UIO_READ);
 	if (result) {
 		bitmap_destroy(sfs->sfs_freemap);
-		array_destroy(sfs->sfs_vnodes);
 		kfree(sfs);
 		return result;
 	}
@@ -6,14 +6,45 @@
 #include <types.h>
 #include <lib.h>
 #include <synch.h>
-#include <array.h>
 #include <bitmap.h>
 #include <kern/stat.h>
+#include <kern/dirent.h>
 #include <kern/errno.h>
 #include <kern/unistd.h>
 #include <uio.h>
 #include <dev.h>
 #include <sfs.h>
+#include <buf.h>
+#include <dcache.h>
+
+/* Hash chain in sfs_vnhash for inode INO */
+#define SFS_VNHASH(ino)  ((ino) % SFS_VNHASHSIZE)
+
+/* True if directories on SFS use the hashed layout */
+#define SFS_HASHDIRS(sfs) \
+	(((sfs)->sfs_super.sp_features & SFS_FEATURE_HASHDIR) != 0)
+
+/* True if files on SFS are mapped with extents */
+#define SFS_EXTENTS(sfs) \
+	(((sfs)->sfs_super.sp_features & SFS_FEATURE_EXTENTS) != 0)
+
+/* The inode of SV viewed as an extent inode */
+#define SFS_XINODE(sv)  ((struct sfs_xinode *)&(sv)->sv_i)
+
+/* Levels of indirect blocks: single, double, triple */
+#define SFS_NIDLEVELS  3
+
+/* Largest number of blocks a block-mapped file can have */
+#define SFS_MAXFILEBLOCKS  (SFS_NDIRECT + SFS_DBPERIDB + \
+			    SFS_DBPERIDB * SFS_DBPERIDB + \
+			    SFS_DBPERIDB * SFS_DBPERIDB * SFS_DBPERIDB)
+
+/* Largest number of blocks moved by one request in sfs_runio */
+#define SFS_MAXRUN  64
+
+/* Read-ahead window, in blocks: first size and largest size */
+#define SFS_RAMIN  4
+#define SFS_RAMAX  64
 
 /* At bottom of file */
 static int 
@@ -29,13 +60,46 @@ static
 int
 sfs_clearblock(struct sfs_fs *sfs, u_int32_t block)
 {
-	/* static -> automatically initialized to zero */
-	static char zeros[SFS_BLOCKSIZE];
-	return sfs_wblock(sfs, zeros, block);
+	struct buf *b;
+	int result;
+
+	result = buf_get(sfs->sfs_device, block, &b);
+	if (result) {
+		return result;
+	}
+	bzero(b->b_data, SFS_BLOCKSIZE);
+	buf_markdirty(b);
+	buf_release(b);
+	return 0;
 }
 
-/* Write an on-disk inode structure back out to disk. */
+/*
+ * Mark an inode modified, and put it on the filesystem's list of
+ * dirty vnodes so sfs_sync can find it without looking at the rest.
+ */
 static
+void
+sfs_dirty(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+
+	if (sv->sv_dirty) {
+		return;
+	}
+	sv->sv_dirty = 1;
+
+	sv->sv_dirtyprev = NULL;
+	sv->sv_dirtynext = sfs->sfs_dirtyvnodes;
+	if (sv->sv_dirtynext != NULL) {
+		sv->sv_dirtynext->sv_dirtyprev = sv;
+	}
+	sfs->sfs_dirtyvnodes = sv;
+}
+
+/*
+ * Write an on-disk inode structure back out to disk. (It goes into the
+ * buffer cache; the cache writes it to disk later, or now if asked.)
+ */
 int
 sfs_sync_inode(struct sfs_vnode *sv)
 {
@@ -46,6 +110,18 @@ sfs_sync_inode(struct sfs_vnode *sv)
 			return result;
 		}
 		sv->sv_dirty = 0;
+
+		/* Take it off the dirty list */
+		if (sv->sv_dirtyprev != NULL) {
+			sv->sv_dirtyprev->sv_dirtynext = sv->sv_dirtynext;
+		}
+		else {
+			sfs->sfs_dirtyvnodes = sv->sv_dirtynext;
+		}
+		if (sv->sv_dirtynext != NULL) {
+			sv->sv_dirtynext->sv_dirtyprev = sv->sv_dirtyprev;
+		}
+		sv->sv_dirtyprev = sv->sv_dirtynext = NULL;
 	}
 	return 0;
 }
@@ -54,16 +130,19 @@ sfs_sync_inode(struct sfs_vnode *sv)
 //
 // Space allocation
 
+/* Number of free blocks to set aside for a file being appended to */
+#define SFS_RESERVE  8
+
 /*
- * Allocate a block.
+ * Allocate a block: the first free one at or after GOAL.
  */
 static
 int
-sfs_balloc(struct sfs_fs *sfs, u_int32_t *diskblock)
+sfs_balloc(struct sfs_fs *sfs, u_int32_t goal, u_int32_t *diskblock)
 {
 	int result;
 
-	result = bitmap_alloc(sfs->sfs_freemap, diskblock);
+	result = bitmap_alloc_near(sfs->sfs_freemap, goal, diskblock);
 	if (result) {
 		return result;
 	}
@@ -102,10 +181,393 @@ sfs_bused(struct sfs_fs *sfs, u_int32_t diskblock)
 	return bitmap_isset(sfs->sfs_freemap, diskblock);
 }
 
+/*
+ * Give back any blocks set aside for appending to a file.
+ */
+static
+void
+sfs_unreserve(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+
+	while (sv->sv_rsvcount > 0) {
+		sfs_bfree(sfs, sv->sv_rsvstart);
+		sv->sv_rsvstart++;
+		sv->sv_rsvcount--;
+	}
+}
+
+/*
+ * Allocate a block for a file, as close after GOAL as possible.
+ *
+ * When APPENDING, also set aside the free blocks that follow the new
+ * one (up to SFS_RESERVE of them). The file's next allocation will
+ * normally ask for exactly the first of those, and gets it even if
+ * other files have been allocating in the meantime, so files that
+ * grow at the same time don't end up interleaved on disk.
+ */
+static
+int
+sfs_file_balloc(struct sfs_vnode *sv, u_int32_t goal, int appending,
+		u_int32_t *diskblock)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	u_int32_t block;
+	int result;
+
+	if (sv->sv_rsvcount > 0 && sv->sv_rsvstart == goal) {
+		/* Take it from the reservation; it's already marked used */
+		*diskblock = sv->sv_rsvstart;
+		sv->sv_rsvstart++;
+		sv->sv_rsvcount--;
+		return sfs_clearblock(sfs, *diskblock);
+	}
+
+	/* The file isn't growing where we expected; start over */
+	sfs_unreserve(sv);
+
+	result = sfs_balloc(sfs, goal, diskblock);
+	if (result) {
+		return result;
+	}
+
+	if (appending) {
+		sv->sv_rsvstart = *diskblock + 1;
+		for (block = sv->sv_rsvstart;
+		     sv->sv_rsvcount < SFS_RESERVE &&
+			     block < sfs->sfs_super.sp_nblocks &&
+			     !sfs_bused(sfs, block);
+		     block++) {
+			bitmap_mark(sfs->sfs_freemap, block);
+			sv->sv_rsvcount++;
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+//
+// Extents (SFS_FEATURE_EXTENTS; see kern/sfs.h)
+
+/*
+ * Find the extent holding block FILEBLOCK of a file. Hands back its
+ * index and the file block the extent starts at. If FILEBLOCK is past
+ * the last extent, the index is the number of extents and the base is
+ * where the next extent would start.
+ */
+static
+void
+sfs_xfind(struct sfs_xinode *sxi, u_int32_t fileblock,
+	  u_int32_t *ix, u_int32_t *base)
+{
+	u_int32_t i, b = 0;
+
+	for (i=0; i<sxi->sxi_nextents; i++) {
+		if (fileblock < b + sxi->sxi_extents[i].sx_len) {
+			break;
+		}
+		b += sxi->sxi_extents[i].sx_len;
+	}
+	*ix = i;
+	*base = b;
+}
+
+/*
+ * Replace NREMOVE extents starting at IX with the NPIECES extents in
+ * PIECES, then merge neighbours that can be merged: adjacent holes,
+ * and extents that continue each other on disk. Fails with ENOSPC,
+ * changing nothing, if the result doesn't fit in the inode.
+ */
+static
+int
+sfs_xsplice(struct sfs_xinode *sxi, u_int32_t ix, u_int32_t nremove,
+	    const struct sfs_extent *pieces, u_int32_t npieces)
+{
+	struct sfs_extent *tmp;
+	u_int32_t i, n, m;
+
+	assert(npieces <= 3);
+	assert(ix + nremove <= sxi->sxi_nextents);
+
+	tmp = kmalloc((SFS_NEXTENTS + 3) * sizeof(struct sfs_extent));
+	if (tmp == NULL) {
+		return ENOMEM;
+	}
+
+	n = 0;
+	for (i=0; i<ix; i++) {
+		tmp[n++] = sxi->sxi_extents[i];
+	}
+	for (i=0; i<npieces; i++) {
+		tmp[n++] = pieces[i];
+	}
+	for (i=ix+nremove; i<sxi->sxi_nextents; i++) {
+		tmp[n++] = sxi->sxi_extents[i];
+	}
+
+	/* Merge in place */
+	m = 0;
+	for (i=0; i<n; i++) {
+		if (tmp[i].sx_len == 0) {
+			continue;
+		}
+		if (m > 0 &&
+		    ((tmp[m-1].sx_start == 0 && tmp[i].sx_start == 0) ||
+		     (tmp[m-1].sx_start != 0 &&
+		      tmp[m-1].sx_start + tmp[m-1].sx_len == tmp[i].sx_start))) {
+			tmp[m-1].sx_len += tmp[i].sx_len;
+			continue;
+		}
+		tmp[m++] = tmp[i];
+	}
+
+	if (m > SFS_NEXTENTS) {
+		kfree(tmp);
+		return ENOSPC;
+	}
+
+	for (i=0; i<m; i++) {
+		sxi->sxi_extents[i] = tmp[i];
+	}
+	sxi->sxi_nextents = m;
+
+	kfree(tmp);
+	return 0;
+}
+
+/*
+ * sfs_bmap for extent-mapped files.
+ */
+static
+int
+sfs_xbmap(struct sfs_vnode *sv, u_int32_t fileblock, int doalloc,
+	  u_int32_t *diskblock)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct sfs_xinode *sxi = SFS_XINODE(sv);
+	struct sfs_extent pieces[3];
+	u_int32_t ix, base, off, i, np, nremove;
+	u_int32_t block, goal;
+	int appending, result;
+
+	sfs_xfind(sxi, fileblock, &ix, &base);
+
+	if (ix < sxi->sxi_nextents && sxi->sxi_extents[ix].sx_start != 0) {
+		/* It's mapped */
+		block = sxi->sxi_extents[ix].sx_start + (fileblock - base);
+		if (!sfs_bused(sfs, block)) {
+			panic("sfs: Data block %u (block %u of file %u) "
+			      "marked free\n", block, fileblock, sv->sv_ino);
+		}
+		*diskblock = block;
+		return 0;
+	}
+
+	/* It's in a hole, or past the end */
+	if (!doalloc) {
+		*diskblock = 0;
+		return 0;
+	}
+
+	/* Allocate after the last data before it, or after the inode */
+	goal = sv->sv_ino + 1;
+	for (i=ix; i>0; i--) {
+		if (sxi->sxi_extents[i-1].sx_start != 0) {
+			goal = sxi->sxi_extents[i-1].sx_start +
+				sxi->sxi_extents[i-1].sx_len;
+			break;
+		}
+	}
+
+	appending = ((off_t)fileblock * SFS_BLOCKSIZE >=
+		     (off_t)sv->sv_i.sfi_size);
+	result = sfs_file_balloc(sv, goal, appending, &block);
+	if (result) {
+		return result;
+	}
+
+	/* Put it in the middle of whatever hole it's in */
+	np = 0;
+	off = fileblock - base;
+	if (off > 0) {
+		pieces[np].sx_start = 0;
+		pieces[np].sx_len = off;
+		np++;
+	}
+	pieces[np].sx_start = block;
+	pieces[np].sx_len = 1;
+	np++;
+	if (ix < sxi->sxi_nextents) {
+		/* The rest of the hole */
+		pieces[np].sx_start = 0;
+		pieces[np].sx_len = sxi->sxi_extents[ix].sx_len - off - 1;
+		np++;
+		nremove = 1;
+	}
+	else {
+		nremove = 0;
+	}
+
+	result = sfs_xsplice(sxi, ix, nremove, pieces, np);
+	if (result) {
+		sfs_bfree(sfs, block);
+		return result;
+	}
+	sfs_dirty(sv);
+
+	*diskblock = block;
+	return 0;
+}
+
+/*
+ * sfs_truncate's block freeing for extent-mapped files: discard
+ * everything from file block BLOCKLEN on.
+ */
+static
+void
+sfs_xtruncate(struct sfs_vnode *sv, u_int32_t blocklen)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct sfs_xinode *sxi = SFS_XINODE(sv);
+	struct sfs_extent *sx;
+	u_int32_t i, j, base, keep, n;
+
+	base = 0;
+	n = 0;
+	for (i=0; i<sxi->sxi_nextents; i++) {
+		sx = &sxi->sxi_extents[i];
+
+		keep = 0;
+		if (base < blocklen) {
+			keep = blocklen - base;
+			if (keep > sx->sx_len) {
+				keep = sx->sx_len;
+			}
+		}
+		base += sx->sx_len;
+
+		if (sx->sx_start != 0) {
+			for (j=keep; j<sx->sx_len; j++) {
+				sfs_bfree(sfs, sx->sx_start + j);
+			}
+		}
+		sx->sx_len = keep;
+		if (keep > 0) {
+			n = i+1;
+		}
+	}
+
+	/* Don't leave a hole at the end */
+	while (n > 0 && sxi->sxi_extents[n-1].sx_start == 0) {
+		n--;
+	}
+
+	if (n != sxi->sxi_nextents) {
+		sxi->sxi_nextents = n;
+		sfs_dirty(sv);
+	}
+}
+
 ////////////////////////////////////////////////////////////
 //
 // Block mapping/inode maintenance
 
+/*
+ * The inode field holding the top indirect block with LEVEL levels of
+ * indirection.
+ */
+static
+u_int32_t *
+sfs_idroot(struct sfs_vnode *sv, int level)
+{
+	switch (level) {
+	    case 1: return &sv->sv_i.sfi_indirect;
+	    case 2: return &sv->sv_i.sfi_dindirect;
+	    case 3: return &sv->sv_i.sfi_tindirect;
+	}
+	panic("sfs: sfs_idroot: invalid level %d\n", level);
+	return NULL;
+}
+
+/*
+ * Free the parts of an indirect tree that map file blocks BLOCKLEN and
+ * up. The tree is rooted at indirect block IDBLOCK, has LEVEL levels,
+ * and maps file blocks starting at BASE. Subtrees that lie entirely
+ * before BLOCKLEN aren't read. If nothing is left in the tree, IDBLOCK
+ * is freed too and *EMPTY is set.
+ */
+static
+int
+sfs_truncate_tree(struct sfs_fs *sfs, u_int32_t idblock, int level,
+		  u_int32_t base, u_int32_t blocklen, int *empty)
+{
+	struct buf *b;
+	u_int32_t *idbuf;
+	u_int32_t span, first, j;
+	int i, result, hasnonzero, iddirty, subempty;
+
+	/* Blocks mapped by each entry */
+	span = 1;
+	for (i=1; i<level; i++) {
+		span *= SFS_DBPERIDB;
+	}
+
+	result = buf_read(sfs->sfs_device, idblock, &b);
+	if (result) {
+		return result;
+	}
+	idbuf = b->b_data;
+
+	hasnonzero = 0;
+	iddirty = 0;
+	for (j=0; j<SFS_DBPERIDB; j++) {
+		if (idbuf[j] == 0) {
+			continue;
+		}
+		first = base + j*span;
+		if (first + span <= blocklen) {
+			/* All of it stays */
+			hasnonzero = 1;
+			continue;
+		}
+
+		if (level == 1) {
+			sfs_bfree(sfs, idbuf[j]);
+			subempty = 1;
+		}
+		else {
+			result = sfs_truncate_tree(sfs, idbuf[j], level-1,
+						   first, blocklen, &subempty);
+			if (result) {
+				if (iddirty) {
+					buf_markdirty(b);
+				}
+				buf_release(b);
+				return result;
+			}
+		}
+
+		if (subempty) {
+			idbuf[j] = 0;
+			iddirty = 1;
+		}
+		else {
+			hasnonzero = 1;
+		}
+	}
+
+	if (iddirty) {
+		buf_markdirty(b);
+	}
+	buf_release(b);
+
+	*empty = !hasnonzero;
+	if (*empty) {
+		sfs_bfree(sfs, idblock);
+	}
+	return 0;
+}
+
 /*
  * Look up the disk block number (from 0 up to the number of blocks on
  * the disk) given a file and the logical block number within that
@@ -117,22 +579,30 @@ int
 sfs_bmap(struct sfs_vnode *sv, u_int32_t fileblock, int doalloc,
 	    u_int32_t *diskblock)
 {
-	/*
-	 * I/O buffer for handling indirect blocks.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static u_int32_t idbuf[SFS_DBPERIDB];
-
 	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct buf *b;
+	u_int32_t *idbuf;
 	u_int32_t block;
-	u_int32_t idblock;
-	u_int32_t idnum, idoff;
+	u_int32_t idblock, idbase;
+	u_int32_t idx, idoff, span;
+	u_int32_t goal;
+	int level;
 	int result;
+	int appending;
 
-	assert(sizeof(idbuf)==SFS_BLOCKSIZE);
+	if (SFS_EXTENTS(sfs)) {
+		return sfs_xbmap(sv, fileblock, doalloc, diskblock);
+	}
+
+	/* Are we extending the file? (If so, allocate with reservation.) */
+	appending = ((off_t)fileblock * SFS_BLOCKSIZE >=
+		     (off_t)sv->sv_i.sfi_size);
+
+	/*
+	 * New blocks go right after the block before them in the file,
+	 * or after the inode for the first one.
+	 */
+	goal = sv->sv_ino + 1;
 
 	/*
 	 * If the block we want is one of the direct blocks...
@@ -147,14 +617,17 @@ sfs_bmap(struct sfs_vnode *sv, u_int32_t fileblock, int doalloc,
 		 * Do we need to allocate?
 		 */
 		if (block==0 && doalloc) {
-			result = sfs_balloc(sfs, &block);
+			if (fileblock > 0 && sv->sv_i.sfi_direct[fileblock-1]) {
+				goal = sv->sv_i.sfi_direct[fileblock-1] + 1;
+			}
+			result = sfs_file_balloc(sv, goal, appending, &block);
 			if (result) {
 				return result;
 			}
 
 			/* Remember what we allocated; mark inode dirty */
 			sv->sv_i.sfi_direct[fileblock] = block;
-			sv->sv_dirty = 1;
+			sfs_dirty(sv);
 		}
 
 		/*
@@ -169,94 +642,171 @@ sfs_bmap(struct sfs_vnode *sv, u_int32_t fileblock, int doalloc,
 	}
 
 	/*
-	 * It's not a direct block; it must be in the indirect block.
-	 * Subtract off the number of direct blocks, so FILEBLOCK is
-	 * now the offset into the indirect block space.
+	 * It's not a direct block; it must be under one of the indirect
+	 * blocks. Subtract off the blocks mapped before each level
+	 * until IDX is the offset into the space mapped at LEVEL.
 	 */
+	idx = fileblock - SFS_NDIRECT;
+	span = SFS_DBPERIDB;
+	level = 1;
+	while (idx >= span) {
+		idx -= span;
+		if (level == SFS_NIDLEVELS) {
+			/* Bigger than the biggest file */
+			return EINVAL;
+		}
+		level++;
+		span *= SFS_DBPERIDB;
+	}
 
-	fileblock -= SFS_NDIRECT;
-
-	/* Get the indirect block number and offset w/i that indirect block */
-	idnum = fileblock / SFS_DBPERIDB;
-	idoff = fileblock % SFS_DBPERIDB;
+	/*
+	 * New blocks, indirect ones included, go after the block before
+	 * this one in the file.
+	 */
+	if (doalloc) {
+		result = sfs_bmap(sv, fileblock-1, 0, &block);
+		if (result) {
+			return result;
+		}
+		if (block != 0) {
+			goal = block + 1;
+		}
+	}
 
 	/*
-	 * We only have one indirect block. If the offset we were asked for
-	 * is too large, we can't handle it, so fail.
+	 * If we've already been through the last-level indirect block
+	 * for this part of the file, start there.
 	 */
-	if (idnum > 0) {
-		return EINVAL;
+	idbase = fileblock - idx % SFS_DBPERIDB;
+	if (sv->sv_idblock != 0 && sv->sv_idbase == idbase) {
+		idblock = sv->sv_idblock;
+		span = 1;
+		level = 1;
+	}
+	else {
+		idblock = *sfs_idroot(sv, level);
+		if (idblock==0 && !doalloc) {
+			/*
+			 * There's no indirect block allocated. We
+			 * weren't asked to allocate anything, so
+			 * pretend it was filled with all zeros.
+			 */
+			*diskblock = 0;
+			return 0;
+		}
+		else if (idblock==0) {
+			result = sfs_file_balloc(sv, goal, appending, &idblock);
+			if (result) {
+				return result;
+			}
+			*sfs_idroot(sv, level) = idblock;
+			sfs_dirty(sv);
+			goal = idblock + 1;
+		}
+		span /= SFS_DBPERIDB;
 	}
 
-	/* Get the disk block number of the indirect block. */
-	idblock = sv->sv_i.sfi_indirect;
+	/*
+	 * Walk down the tree. SPAN is the number of file blocks mapped by
+	 * each entry of IDBLOCK. (sfs_balloc zeroes new blocks, so new
+	 * indirect blocks start out empty.)
+	 */
+	for (; level > 0; level--, span /= SFS_DBPERIDB) {
+		if (level == 1) {
+			sv->sv_idbase = idbase;
+			sv->sv_idblock = idblock;
+		}
 
-	if (idblock==0 && !doalloc) {
-		/*
-		 * There's no indirect block allocated. We weren't
-		 * asked to allocate anything, so pretend the indirect
-		 * block was filled with all zeros.
-		 */
-		*diskblock = 0;
-		return 0;
-	}
-	else if (idblock==0) {
-		/*
-		 * There's no indirect block allocated, but we need to
-		 * allocate a block whose number needs to be stored in
-		 * the indirect block. Thus, we need to allocate an
-		 * indirect block.
-		 */
-		result = sfs_balloc(sfs, &idblock);
+		result = buf_read(sfs->sfs_device, idblock, &b);
 		if (result) {
 			return result;
 		}
+		idbuf = b->b_data;
+		idoff = (idx / span) % SFS_DBPERIDB;
 
-		/* Remember the block we just allocated */
-		sv->sv_i.sfi_indirect = idblock;
-
-		/* Mark the inode dirty */
-		sv->sv_dirty = 1;
+		block = idbuf[idoff];
+		if (block==0 && doalloc) {
+			result = sfs_file_balloc(sv, goal, appending, &block);
+			if (result) {
+				buf_release(b);
+				return result;
+			}
+			idbuf[idoff] = block;
+			buf_markdirty(b);
+			goal = block + 1;
+		}
+		buf_release(b);
 
-		/* Clear the indirect block buffer */
-		bzero(idbuf, sizeof(idbuf));
-	}
-	else {
-		/*
-		 * We already have an indirect block allocated; load it.
-		 */
-		result = sfs_rblock(sfs, idbuf, idblock);
-		if (result) {
-			return result;
+		if (block == 0) {
+			break;
 		}
+		idblock = block;
+	}
+
+	/* Hand back the result and return. */
+	if (block != 0 && !sfs_bused(sfs, block)) {
+		panic("sfs: Data block %u (block %u of file %u) marked free\n",
+		      block, fileblock, sv->sv_ino);
 	}
+	*diskblock = block;
+	return 0;
+}
+
+/*
+ * Find out how many blocks of a file, starting at FILEBLOCK and up to
+ * MAXRUN of them, sit in consecutive blocks on disk. Hands back the
+ * disk block of the first and the length of the run. A run of holes
+ * comes back as disk block 0. Doesn't allocate anything.
+ */
+static
+int
+sfs_bmaprun(struct sfs_vnode *sv, u_int32_t fileblock, u_int32_t maxrun,
+	    u_int32_t *diskblock, u_int32_t *run)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct sfs_xinode *sxi;
+	struct sfs_extent *sx;
+	u_int32_t ix, base, off, first, block, i;
+	int result;
 
-	/* Get the block out of the indirect block buffer */
-	block = idbuf[idoff];
+	assert(maxrun > 0);
 
-	/* If there's no block there, allocate one */
-	if (block==0 && doalloc) {
-		result = sfs_balloc(sfs, &block);
-		if (result) {
-			return result;
+	if (SFS_EXTENTS(sfs)) {
+		sxi = SFS_XINODE(sv);
+		sfs_xfind(sxi, fileblock, &ix, &base);
+		if (ix == sxi->sxi_nextents) {
+			/* Past the end: all hole */
+			*diskblock = 0;
+			*run = maxrun;
+			return 0;
 		}
+		sx = &sxi->sxi_extents[ix];
+		off = fileblock - base;
+		*diskblock = sx->sx_start==0 ? 0 : sx->sx_start + off;
+		*run = sx->sx_len - off;
+		if (*run > maxrun) {
+			*run = maxrun;
+		}
+		return 0;
+	}
 
-		/* Remember the block we allocated */
-		idbuf[idoff] = block;
-
-		/* The indirect block is now dirty; write it back */
-		result = sfs_wblock(sfs, idbuf, idblock);
+	result = sfs_bmap(sv, fileblock, 0, &first);
+	if (result) {
+		return result;
+	}
+	for (i=1; i<maxrun; i++) {
+		result = sfs_bmap(sv, fileblock+i, 0, &block);
 		if (result) {
-			return result;
+			/* Past the largest file; stop the run here */
+			break;
+		}
+		if (first==0 ? block!=0 : block!=first+i) {
+			break;
 		}
 	}
 
-	/* Hand back the result and return. */
-	if (block != 0 && !sfs_bused(sfs, block)) {
-		panic("sfs: Data block %u (block %u of file %u) marked free\n",
-		      block, fileblock, sv->sv_ino);
-	}
-	*diskblock = block;
+	*diskblock = first;
+	*run = i;
 	return 0;
 }
 
@@ -266,9 +816,9 @@ sfs_bmap(struct sfs_vnode *sv, u_int32_t fileblock, int doalloc,
 
 /*
  * Do I/O to a block of a file that doesn't cover the whole block.  We
- * need to read in the original block first, even if we're writing, so
- * we don't clobber the portion of the block we're not intending to
- * write over.
+ * need the original block in the buffer cache first, even if we're
+ * writing, so we don't clobber the portion of the block we're not
+ * intending to write over.
  *
  * skipstart is the number of bytes to skip past at the beginning of
  * the sector; len is the number of bytes to actually read or write.
@@ -279,16 +829,8 @@ int
 sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	      u_int32_t skipstart, u_int32_t len)
 {
-	/*
-	 * I/O buffer for handling partial sectors.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static char iobuf[SFS_BLOCKSIZE];
-
 	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct buf *b;
 	u_int32_t diskblock;
 	u_int32_t fileblock;
 	int result;
@@ -310,40 +852,40 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	if (diskblock == 0) {
 		/*
 		 * There was no block mapped at this point in the file.
-		 * Zero the buffer.
+		 * It reads as zeros.
 		 */
 		assert(uio->uio_rw == UIO_READ);
-		bzero(iobuf, sizeof(iobuf));
-	}
-	else {
-		/*
-		 * Read the block.
-		 */
-		result = sfs_rblock(sfs, iobuf, diskblock);
-		if (result) {
-			return result;
-		}
+		return uiomovezeros(len, uio);
 	}
 
 	/*
-	 * Now perform the requested operation into/out of the buffer.
+	 * Get the block.
 	 */
-	result = uiomove(iobuf+skipstart, len, uio);
+	result = buf_read(sfs->sfs_device, diskblock, &b);
 	if (result) {
 		return result;
 	}
 
 	/*
-	 * If it was a write, write back the modified block.
+	 * Now perform the requested operation into/out of the buffer.
 	 */
-	if (uio->uio_rw == UIO_WRITE) {
-		result = sfs_wblock(sfs, iobuf, diskblock);
-		if (result) {
-			return result;
-		}
+	result = uiomove((char *)b->b_data+skipstart, len, uio);
+
+	/*
+	 * If it was a write, the block is now dirty; it gets written
+	 * back when the cache gets around to it. If the write failed
+	 * partway, don't leave the half-changed block in the cache.
+	 */
+	if (result && uio->uio_rw == UIO_WRITE) {
+		buf_invalidate(b);
+		return result;
+	}
+	if (result == 0 && uio->uio_rw == UIO_WRITE) {
+		buf_markdirty(b);
 	}
+	buf_release(b);
 
-	return 0;
+	return result;
 }
 
 /*
@@ -354,14 +896,11 @@ int
 sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 {
 	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct buf *b;
 	u_int32_t diskblock;
 	u_int32_t fileblock;
 	int result;
 	int doalloc = (uio->uio_rw==UIO_WRITE);
-	off_t saveoff;
-	off_t diskoff;
-	off_t saveres;
-	off_t diskres;
 
 	/* Get the block number within the file */
 	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
@@ -384,33 +923,154 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 	}
 
 	/*
-	 * Do the I/O directly to the uio region. Save the uio_offset,
-	 * and substitute one that makes sense to the device.
-	 */
-	saveoff = uio->uio_offset;
-	diskoff = diskblock * SFS_BLOCKSIZE;
-	uio->uio_offset = diskoff;
-
-	/*
-	 * Temporarily set the residue to be one block size.
+	 * Go through the buffer cache. A write replaces the whole
+	 * block, so there's no need to read the old contents.
 	 */
 	assert(uio->uio_resid >= SFS_BLOCKSIZE);
-	saveres = uio->uio_resid;
-	diskres = SFS_BLOCKSIZE;
-	uio->uio_resid = diskres;
-	
-	result = sfs_rwblock(sfs, uio);
+	if (uio->uio_rw == UIO_READ) {
+		result = buf_read(sfs->sfs_device, diskblock, &b);
+	}
+	else {
+		result = buf_get(sfs->sfs_device, diskblock, &b);
+	}
+	if (result) {
+		return result;
+	}
 
-	/*
-	 * Now, restore the original uio_offset and uio_resid and update 
-	 * them by the amount of I/O done.
-	 */
-	uio->uio_offset = (uio->uio_offset - diskoff) + saveoff;
-	uio->uio_resid = (uio->uio_resid - diskres) + saveres;
+	result = uiomove(b->b_data, SFS_BLOCKSIZE, uio);
+	if (result && uio->uio_rw == UIO_WRITE) {
+		/* Don't leave zeros or half a block in the cache */
+		buf_invalidate(b);
+		return result;
+	}
+	if (result == 0 && uio->uio_rw == UIO_WRITE) {
+		buf_markdirty(b);
+	}
+	buf_release(b);
 
 	return result;
 }
 
+/*
+ * Do I/O of up to MAXBLOCKS whole blocks, as many as lie in one run of
+ * consecutive disk blocks (see sfs_bmaprun). When reading, a run of
+ * more than one block goes to the device as a single request; a single
+ * block goes through the buffer cache. Writes always go through the
+ * cache, which writes them back later in clusters. Hands back the
+ * number of blocks done.
+ */
+static
+int
+sfs_runio(struct sfs_vnode *sv, struct uio *uio, u_int32_t maxblocks,
+	  u_int32_t *done)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	u_int32_t fileblock, diskblock, run;
+	int result;
+
+	if (uio->uio_rw == UIO_WRITE) {
+		*done = 1;
+		return sfs_blockio(sv, uio);
+	}
+
+	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
+	if (maxblocks > SFS_MAXRUN) {
+		maxblocks = SFS_MAXRUN;
+	}
+
+	if (sv->sv_rawindow > 0) {
+		/* It's being read ahead into the cache; get it from there */
+		maxblocks = 1;
+	}
+
+	result = sfs_bmaprun(sv, fileblock, maxblocks, &diskblock, &run);
+	if (result) {
+		return result;
+	}
+
+	if (diskblock == 0) {
+		/* Hole */
+		result = uiomovezeros(run * SFS_BLOCKSIZE, uio);
+	}
+	else if (run == 1) {
+		result = sfs_blockio(sv, uio);
+	}
+	else {
+		result = buf_directio(sfs->sfs_device, diskblock, run, uio);
+	}
+	if (result) {
+		return result;
+	}
+
+	*done = run;
+	return 0;
+}
+
+/*
+ * Read-ahead. Called before reading the region UIO covers. If the read
+ * starts where the last one left off, grow the window and, once the
+ * reader is within half a window of what has been read ahead, start
+ * reading the rest of the window into the buffer cache. Any other
+ * read closes the window.
+ */
+static
+void
+sfs_readahead(struct sfs_vnode *sv, struct uio *uio)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	u_int32_t first, next, end, eofblock;
+	u_int32_t diskblock, run;
+
+	if (uio->uio_resid == 0) {
+		return;
+	}
+
+	first = uio->uio_offset / SFS_BLOCKSIZE;
+	next = (uio->uio_offset + uio->uio_resid) / SFS_BLOCKSIZE;
+
+	if (first != sv->sv_ranext) {
+		/* Not sequential */
+		sv->sv_ranext = next;
+		sv->sv_rawindow = 0;
+		sv->sv_raend = 0;
+		return;
+	}
+	sv->sv_ranext = next;
+
+	if (sv->sv_rawindow == 0) {
+		sv->sv_rawindow = SFS_RAMIN;
+	}
+	else if (sv->sv_rawindow < SFS_RAMAX) {
+		sv->sv_rawindow *= 2;
+	}
+
+	/* Far enough ahead already? */
+	if (sv->sv_raend > next + sv->sv_rawindow/2) {
+		return;
+	}
+
+	end = next + sv->sv_rawindow;
+	eofblock = DIVROUNDUP(sv->sv_i.sfi_size, SFS_BLOCKSIZE);
+	if (end > eofblock) {
+		end = eofblock;
+	}
+
+	/* Issue one request per run of consecutive disk blocks */
+	if (sv->sv_raend < first) {
+		sv->sv_raend = first;
+	}
+	while (sv->sv_raend < end) {
+		if (sfs_bmaprun(sv, sv->sv_raend, end - sv->sv_raend,
+				&diskblock, &run)) {
+			break;
+		}
+		if (diskblock != 0) {
+			buf_readahead(sfs->sfs_device, diskblock, run);
+		}
+		sv->sv_raend += run;
+	}
+}
+
 /*
  * Do I/O of a whole region of data, whether or not it's block-aligned.
  */
@@ -419,7 +1079,7 @@ int
 sfs_io(struct sfs_vnode *sv, struct uio *uio)
 {
 	u_int32_t blkoff;
-	u_int32_t nblocks, i;
+	u_int32_t nblocks, done;
 	int result = 0;
 	u_int32_t extraresid = 0;
 
@@ -442,6 +1102,8 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 			assert(uio->uio_resid > extraresid);
 			uio->uio_resid -= extraresid;
 		}
+
+		sfs_readahead(sv, uio);
 	}
 
 	/*
@@ -473,15 +1135,18 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	}
 
 	/*
-	 * Now we should be block-aligned. Do the remaining whole blocks.
+	 * Now we should be block-aligned. Do the remaining whole blocks,
+	 * a run of contiguous ones at a time.
 	 */
 	assert(uio->uio_offset % SFS_BLOCKSIZE == 0);
 	nblocks = uio->uio_resid / SFS_BLOCKSIZE;
-	for (i=0; i<nblocks; i++) {
-		result = sfs_blockio(sv, uio);
+	while (nblocks > 0) {
+		result = sfs_runio(sv, uio, nblocks, &done);
 		if (result) {
 			goto out;
 		}
+		assert(done > 0 && done <= nblocks);
+		nblocks -= done;
 	}
 
 	/*
@@ -502,7 +1167,7 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	if (uio->uio_rw == UIO_WRITE && 
 	    uio->uio_offset > (off_t)sv->sv_i.sfi_size) {
 		sv->sv_i.sfi_size = uio->uio_offset;
-		sv->sv_dirty = 1;
+		sfs_dirty(sv);
 	}
 
 	/* Add in any extra amount we couldn't read because of EOF */
@@ -517,22 +1182,67 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 // Directory I/O
 
 /*
- * Read the directory entry out of slot SLOT of a directory vnode.
- * The "slot" is the index of the directory entry, starting at 0.
+ * Compute the number of entries in a directory.
+ * This actually computes the number of existing slots, and does not
+ * account for empty slots.
+ */
+static
+int
+sfs_dir_nentries(struct sfs_vnode *sv)
+{
+	off_t size;
+
+	assert(sv->sv_i.sfi_type == SFS_TYPE_DIR);
+
+	size = sv->sv_i.sfi_size;
+	if (size % sizeof(struct sfs_dir) != 0) {
+		panic("sfs: directory %u: Invalid size %u\n",
+		      sv->sv_ino, size);
+	}
+
+	return size / sizeof(struct sfs_dir);
+}
+
+/* Number of directory entries in one block */
+#define SFS_DIRPERBLOCK  (SFS_BLOCKSIZE / sizeof(struct sfs_dir))
+
+/*
+ * Read directory entries from a directory vnode, starting at slot SLOT
+ * and going up to the end of the block that slot is in (or the end of
+ * the directory). SD must have room for SFS_DIRPERBLOCK entries. The
+ * number of entries read is handed back in NREAD; 0 means SLOT is past
+ * the end. The "slot" is the index of the directory entry, starting
+ * at 0.
+ *
+ * Going a block at a time means scanning a directory costs one block
+ * read per block rather than one per entry.
  */
 static
 int
-sfs_readdir(struct sfs_vnode *sv, struct sfs_dir *sd, int slot)
+sfs_readdir(struct sfs_vnode *sv, struct sfs_dir *sd, int slot, int *nread)
 {
 	struct uio ku;
 	off_t actualpos;
-	int result;
+	int nentries, n, result;
+
+	assert(slot>=0);
+
+	nentries = sfs_dir_nentries(sv);
+	if (slot >= nentries) {
+		*nread = 0;
+		return 0;
+	}
+
+	n = SFS_DIRPERBLOCK - slot % SFS_DIRPERBLOCK;
+	if (n > nentries - slot) {
+		n = nentries - slot;
+	}
 
 	/* Compute the actual position in the directory to read. */
 	actualpos = slot * sizeof(struct sfs_dir);
 
 	/* Set up a uio to do the read */ 
-	mk_kuio(&ku, sd, sizeof(struct sfs_dir), actualpos, UIO_READ);
+	mk_kuio(&ku, sd, n * sizeof(struct sfs_dir), actualpos, UIO_READ);
 
 	/* do it */
 	result = sfs_io(sv, &ku);
@@ -546,6 +1256,7 @@ sfs_readdir(struct sfs_vnode *sv, struct sfs_dir *sd, int slot)
 	}
 
 	/* Done */
+	*nread = n;
 	return 0;
 }
 
@@ -583,28 +1294,258 @@ sfs_writedir(struct sfs_vnode *sv, struct sfs_dir *sd, int slot)
 	return 0;
 }
 
+////////////////////////////////////////////////////////////
+//
+// Hashed directories (SFS_FEATURE_HASHDIR; see kern/sfs.h)
+
+/* Hash of a name (32-bit FNV-1a). This is part of the disk format. */
+static
+u_int32_t
+sfs_dirhash(const char *name)
+{
+	u_int32_t h = 2166136261U;
+
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/* Number of buckets (blocks) in a hashed directory */
+static
+int
+sfs_hdir_nbuckets(struct sfs_vnode *sv)
+{
+	u_int32_t size = sv->sv_i.sfi_size;
+	int nb = size / SFS_BLOCKSIZE;
+
+	if (size % SFS_BLOCKSIZE != 0 || (nb & (nb-1)) != 0) {
+		panic("sfs: hashed directory %u: Invalid size %u\n",
+		      sv->sv_ino, size);
+	}
+	return nb;
+}
+
 /*
- * Compute the number of entries in a directory.
- * This actually computes the number of existing slots, and does not
- * account for empty slots.
+ * Read or write a whole bucket of a hashed directory. SD holds
+ * SFS_DIRPERBLOCK entries.
+ */
+static
+int
+sfs_hdir_bucketio(struct sfs_vnode *sv, struct sfs_dir *sd, int bucket,
+		  enum uio_rw rw)
+{
+	struct uio ku;
+	int result;
+
+	mk_kuio(&ku, sd, SFS_BLOCKSIZE, ((off_t)bucket)*SFS_BLOCKSIZE, rw);
+	result = sfs_io(sv, &ku);
+	if (result) {
+		return result;
+	}
+
+	if (ku.uio_resid > 0) {
+		panic("sfs: hashed directory %u: Short I/O on bucket %d\n",
+		      sv->sv_ino, bucket);
+	}
+	return 0;
+}
+
+/*
+ * sfs_dir_findname for hashed directories: only the one bucket the
+ * name hashes to needs to be looked at. EMPTYSLOT, if requested, is
+ * only set to a free slot in that bucket.
+ */
+static
+int
+sfs_hdir_findname(struct sfs_vnode *sv, const char *name,
+		  u_int32_t *ino, int *slot, int *emptyslot)
+{
+	struct sfs_dir *tsd;
+	int nb, bucket, j, result;
+	int found = 0;
+
+	nb = sfs_hdir_nbuckets(sv);
+	if (nb == 0) {
+		return ENOENT;
+	}
+	bucket = sfs_dirhash(name) & (nb-1);
+
+	tsd = kmalloc(SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+	if (tsd == NULL) {
+		return ENOMEM;
+	}
+
+	result = sfs_hdir_bucketio(sv, tsd, bucket, UIO_READ);
+	if (result) {
+		kfree(tsd);
+		return result;
+	}
+
+	for (j=0; j<(int)SFS_DIRPERBLOCK; j++) {
+		if (tsd[j].sfd_ino == SFS_NOINO) {
+			if (emptyslot != NULL) {
+				*emptyslot = bucket*SFS_DIRPERBLOCK + j;
+			}
+			continue;
+		}
+
+		/* Ensure null termination, just in case */
+		tsd[j].sfd_name[sizeof(tsd[j].sfd_name)-1] = 0;
+		if (!strcmp(tsd[j].sfd_name, name)) {
+			found = 1;
+			if (slot != NULL) {
+				*slot = bucket*SFS_DIRPERBLOCK + j;
+			}
+			if (ino != NULL) {
+				*ino = tsd[j].sfd_ino;
+			}
+			break;
+		}
+	}
+
+	kfree(tsd);
+	return found ? 0 : ENOENT;
+}
+
+/*
+ * Double the number of buckets in a hashed directory (or create the
+ * first one). Each entry in bucket b either stays there or moves to
+ * bucket b+nb, depending on the next bit of its hash, so this only
+ * ever needs two buckets in memory.
+ */
+static
+int
+sfs_hdir_grow(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct sfs_dir *oldsd, *newsd;
+	int nb, newnb, b, j, k, result;
+
+	nb = sfs_hdir_nbuckets(sv);
+	newnb = nb==0 ? 1 : nb*2;
+	if (!SFS_EXTENTS(sfs) && newnb > SFS_MAXFILEBLOCKS) {
+		return ENOSPC;
+	}
+
+	oldsd = kmalloc(SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+	if (oldsd == NULL) {
+		return ENOMEM;
+	}
+	newsd = kmalloc(SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+	if (newsd == NULL) {
+		kfree(oldsd);
+		return ENOMEM;
+	}
+
+	/*
+	 * Extend the directory by writing its new last bucket. The
+	 * buckets in between are holes until something is put in them.
+	 */
+	bzero(newsd, SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+	result = sfs_hdir_bucketio(sv, newsd, newnb-1, UIO_WRITE);
+	if (result) {
+		goto done;
+	}
+
+	/* Split each old bucket */
+	for (b=0; b<nb; b++) {
+		result = sfs_hdir_bucketio(sv, oldsd, b, UIO_READ);
+		if (result) {
+			goto done;
+		}
+
+		bzero(newsd, SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+		k = 0;
+		for (j=0; j<(int)SFS_DIRPERBLOCK; j++) {
+			if (oldsd[j].sfd_ino == SFS_NOINO) {
+				continue;
+			}
+			oldsd[j].sfd_name[sizeof(oldsd[j].sfd_name)-1] = 0;
+			if ((sfs_dirhash(oldsd[j].sfd_name) & (newnb-1)) ==
+			    (u_int32_t)b) {
+				continue;
+			}
+			newsd[k++] = oldsd[j];
+			bzero(&oldsd[j], sizeof(oldsd[j]));
+		}
+
+		if (k > 0) {
+			/* Write the new copies before erasing the old ones */
+			result = sfs_hdir_bucketio(sv, newsd, b+nb, UIO_WRITE);
+			if (result) {
+				goto done;
+			}
+			result = sfs_hdir_bucketio(sv, oldsd, b, UIO_WRITE);
+			if (result) {
+				goto done;
+			}
+		}
+	}
+
+ done:
+	kfree(newsd);
+	kfree(oldsd);
+	return result;
+}
+
+/*
+ * sfs_dir_link for hashed directories: put the name in its bucket,
+ * growing the directory until the bucket has room.
  */
 static
 int
-sfs_dir_nentries(struct sfs_vnode *sv)
+sfs_hdir_link(struct sfs_vnode *sv, const char *name, u_int32_t ino,
+	      int *slot)
 {
-	off_t size;
+	int emptyslot;
+	int result;
+	struct sfs_dir sd;
 
-	assert(sv->sv_i.sfi_type == SFS_TYPE_DIR);
+	if (strlen(name)+1 > sizeof(sd.sfd_name)) {
+		return ENAMETOOLONG;
+	}
 
-	size = sv->sv_i.sfi_size;
-	if (size % sizeof(struct sfs_dir) != 0) {
-		panic("sfs: directory %u: Invalid size %u\n",
-		      sv->sv_ino, size);
+	while (1) {
+		/* Make sure the name *doesn't* exist, and look for room */
+		emptyslot = -1;
+		result = sfs_hdir_findname(sv, name, NULL, NULL, &emptyslot);
+		if (result!=0 && result!=ENOENT) {
+			return result;
+		}
+		if (result==0) {
+			return EEXIST;
+		}
+		if (emptyslot >= 0) {
+			break;
+		}
+
+		/* The bucket is full, or there are no buckets yet */
+		result = sfs_hdir_grow(sv);
+		if (result) {
+			return result;
+		}
 	}
 
-	return size / sizeof(struct sfs_dir);
+	/* Set up the entry. */
+	bzero(&sd, sizeof(sd));
+	sd.sfd_ino = ino;
+	strcpy(sd.sfd_name, name);
+
+	/* Hand back the slot, if so requested. */
+	if (slot) {
+		*slot = emptyslot;
+	}
+
+	/* Write the entry. */
+	return sfs_writedir(sv, &sd, emptyslot);
 }
 
+////////////////////////////////////////////////////////////
+//
+// Directory operations
+
 /*
  * Search a directory for a particular filename in a directory, and
  * return its inode number, its slot, and/or the slot number of an
@@ -616,44 +1557,62 @@ int
 sfs_dir_findname(struct sfs_vnode *sv, const char *name,
 		    u_int32_t *ino, int *slot, int *emptyslot)
 {
-	struct sfs_dir tsd;
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct sfs_dir *tsd;
 	int found = 0;
 	int nentries = sfs_dir_nentries(sv);
-	int i, result;
+	int i, j, n, result;
 
-	/* For each slot... */
-	for (i=0; i<nentries; i++) {
+	if (SFS_HASHDIRS(sfs)) {
+		return sfs_hdir_findname(sv, name, ino, slot, emptyslot);
+	}
+
+	tsd = kmalloc(SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+	if (tsd == NULL) {
+		return ENOMEM;
+	}
 
-		/* Read the entry from that slot */
-		result = sfs_readdir(sv, &tsd, i);
+	/* For each block of slots... */
+	for (i=0; i<nentries; i+=n) {
+
+		/* Read the entries in that block */
+		result = sfs_readdir(sv, tsd, i, &n);
 		if (result) {
+			kfree(tsd);
 			return result;
 		}
-		if (tsd.sfd_ino == SFS_NOINO) {
-			/* Free slot - report it back if one was requested */
-			if (emptyslot != NULL) {
-				*emptyslot = i;
+
+		for (j=0; j<n; j++) {
+			if (tsd[j].sfd_ino == SFS_NOINO) {
+				/*
+				 * Free slot - report it back if one was
+				 * requested
+				 */
+				if (emptyslot != NULL) {
+					*emptyslot = i+j;
+				}
+				continue;
 			}
-		}
-		else {
+
 			/* Ensure null termination, just in case */
-			tsd.sfd_name[sizeof(tsd.sfd_name)-1] = 0;
-			if (!strcmp(tsd.sfd_name, name)) {
+			tsd[j].sfd_name[sizeof(tsd[j].sfd_name)-1] = 0;
+			if (!strcmp(tsd[j].sfd_name, name)) {
 
 				/* Each name may legally appear only once... */
 				assert(found==0);
 
 				found = 1;
 				if (slot != NULL) {
-					*slot = i;
+					*slot = i+j;
 				}
 				if (ino != NULL) {
-					*ino = tsd.sfd_ino;
+					*ino = tsd[j].sfd_ino;
 				}
 			}
 		}
 	}
 
+	kfree(tsd);
 	return found ? 0 : ENOENT;
 }
 
@@ -665,10 +1624,15 @@ static
 int
 sfs_dir_link(struct sfs_vnode *sv, const char *name, u_int32_t ino, int *slot)
 {
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
 	int emptyslot = -1;
 	int result;
 	struct sfs_dir sd;
 
+	if (SFS_HASHDIRS(sfs)) {
+		return sfs_hdir_link(sv, name, ino, slot);
+	}
+
 	/* Look up the name. We want to make sure it *doesn't* exist. */
 	result = sfs_dir_findname(sv, name, NULL, NULL, &emptyslot);
 	if (result!=0 && result!=ENOENT) {
@@ -770,7 +1734,7 @@ sfs_makeobj(struct sfs_fs *sfs, int type, struct sfs_vnode **ret)
 	 * number is the block number, so just get a block.)
 	 */
 
-	result = sfs_balloc(sfs, &ino);
+	result = sfs_balloc(sfs, SFS_ROOT_LOCATION, &ino);
 	if (result) {
 		return result;
 	}
@@ -844,8 +1808,18 @@ static
 int
 sfs_close(struct vnode *v)
 {
-	/* Sync it. */
-	return VOP_FSYNC(v);
+	/*
+	 * Give back blocks set aside for appending; the vnode may stay
+	 * loaded (e.g. in the name cache) long after this.
+	 */
+	sfs_unreserve(v->vn_data);
+
+	/*
+	 * Put the inode in the buffer cache. Don't VOP_FSYNC: that
+	 * waits for the whole file to reach the disk, which only an
+	 * explicit fsync should pay for.
+	 */
+	return sfs_sync_inode(v->vn_data);
 }
 
 /*
@@ -859,7 +1833,8 @@ sfs_reclaim(struct vnode *v)
 {
 	struct sfs_vnode *sv = v->vn_data;
 	struct sfs_fs *sfs = v->vn_fs->fs_data;
-	int ix, i, num, result;
+	struct sfs_vnode **svp;
+	int result;
 
 	/*
 	 * Make sure someone else hasn't picked up the vnode since the
@@ -878,6 +1853,8 @@ sfs_reclaim(struct vnode *v)
 	}
 	lock_release(v->vn_countlock);
 	
+	/* Give back blocks set aside for appending */
+	sfs_unreserve(sv);
 
 	/* If there are no on-disk references to the file either, erase it. */
 	if (sv->sv_i.sfi_linkcount==0) {
@@ -899,20 +1876,19 @@ sfs_reclaim(struct vnode *v)
 	}
 
 	/* Remove the vnode structure from the table in the struct sfs_fs. */
-	ix = -1;
-	num = array_getnum(sfs->sfs_vnodes);
-	for (i=0; i<num; i++) {
-		struct sfs_vnode *sv2 = array_getguy(sfs->sfs_vnodes, i);
-		if (sv2==sv) {
-			ix = i;
-			break;
+	svp = &sfs->sfs_vnhash[SFS_VNHASH(sv->sv_ino)];
+	while (*svp != sv) {
+		if (*svp == NULL) {
+			panic("sfs: reclaim vnode %u not in vnode pool\n",
+			      sv->sv_ino);
 		}
+		svp = &(*svp)->sv_hashnext;
 	}
-	if (ix<0) {
-		panic("sfs: reclaim vnode %u not in vnode pool\n",
-		      sv->sv_ino);
-	}
-	array_remove(sfs->sfs_vnodes, ix);
+	*svp = sv->sv_hashnext;
+	sfs->sfs_nvnodes--;
+
+	/* It was synced above, so it can't be on the dirty list */
+	assert(!sv->sv_dirty);
 
 	VOP_KILL(&sv->sv_v);
 
@@ -935,6 +1911,153 @@ sfs_read(struct vnode *v, struct uio *uio)
 	return sfs_io(sv, uio);
 }
 
+/*
+ * Called for getdirentry(). The offset in the uio is the slot to start
+ * looking at; hand back the next name in use and move past it.
+ */
+static
+int
+sfs_getdirentry(struct vnode *v, struct uio *uio)
+{
+	struct sfs_vnode *sv = v->vn_data;
+	struct sfs_dir *sds;
+	int slot, j, n, result;
+
+	assert(uio->uio_rw==UIO_READ);
+
+	slot = uio->uio_offset;
+	if (slot < 0) {
+		return EINVAL;
+	}
+
+	sds = kmalloc(SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+	if (sds == NULL) {
+		return ENOMEM;
+	}
+
+	while (1) {
+		result = sfs_readdir(sv, sds, slot, &n);
+		if (result || n == 0) {
+			/* error, or end of directory */
+			break;
+		}
+		for (j=0; j<n && sds[j].sfd_ino == SFS_NOINO; j++) {
+			/* skip empty slots */
+		}
+		slot += j;
+		if (j < n) {
+			sds[j].sfd_name[sizeof(sds[j].sfd_name)-1] = 0;
+			result = uiomove(sds[j].sfd_name,
+					 strlen(sds[j].sfd_name), uio);
+			slot++;
+			break;
+		}
+	}
+
+	kfree(sds);
+	uio->uio_offset = slot;
+	return result;
+}
+
+/*
+ * Find the d_type for inode INO, if we can do it without I/O: only
+ * inodes already loaded are looked at. Reading every other inode
+ * would cost a disk read per name; callers who need to know can stat.
+ */
+static
+int
+sfs_dirent_type(struct sfs_fs *sfs, u_int32_t ino)
+{
+	struct sfs_vnode *sv;
+
+	for (sv = sfs->sfs_vnhash[SFS_VNHASH(ino)]; sv != NULL;
+	     sv = sv->sv_hashnext) {
+		if (sv->sv_ino == ino) {
+			return sv->sv_i.sfi_type == SFS_TYPE_DIR ?
+				DT_DIR : DT_REG;
+		}
+	}
+	return DT_UNKNOWN;
+}
+
+/*
+ * Called for getdirentries(). Like sfs_getdirentry, but packs up as
+ * many names as will fit, along with their inode numbers, and their
+ * types where those are known (see sfs_dirent_type).
+ */
+static
+int
+sfs_getdirentries(struct vnode *v, struct uio *uio)
+{
+	struct sfs_vnode *sv = v->vn_data;
+	struct sfs_fs *sfs = v->vn_fs->fs_data;
+	struct sfs_dir *sds;
+	struct dirent *d;
+	size_t namelen, reclen;
+	int slot, j, n, count = 0, done = 0, result;
+
+	assert(uio->uio_rw==UIO_READ);
+
+	slot = uio->uio_offset;
+	if (slot < 0) {
+		return EINVAL;
+	}
+
+	sds = kmalloc(SFS_DIRPERBLOCK * sizeof(struct sfs_dir));
+	if (sds == NULL) {
+		return ENOMEM;
+	}
+	d = kmalloc(sizeof(struct dirent));
+	if (d == NULL) {
+		kfree(sds);
+		return ENOMEM;
+	}
+
+	while (!done) {
+		result = sfs_readdir(sv, sds, slot, &n);
+		if (result || n == 0) {
+			/* error, or end of directory */
+			break;
+		}
+
+		for (j=0; j<n; j++, slot++) {
+			if (sds[j].sfd_ino == SFS_NOINO) {
+				continue;
+			}
+
+			sds[j].sfd_name[sizeof(sds[j].sfd_name)-1] = 0;
+			namelen = strlen(sds[j].sfd_name);
+			reclen = DIRENT_RECLEN(namelen);
+			if (reclen > uio->uio_resid) {
+				if (count == 0) {
+					result = EINVAL;
+				}
+				done = 1;
+				break;
+			}
+
+			bzero(d, reclen);
+			d->d_ino = sds[j].sfd_ino;
+			d->d_reclen = reclen;
+			d->d_type = sfs_dirent_type(sfs, sds[j].sfd_ino);
+			d->d_namlen = namelen;
+			strcpy(d->d_name, sds[j].sfd_name);
+
+			result = uiomove(d, reclen, uio);
+			if (result) {
+				done = 1;
+				break;
+			}
+			count++;
+		}
+	}
+
+	kfree(d);
+	kfree(sds);
+	uio->uio_offset = slot;
+	return result;
+}
+
 /*
  * Called for write(). sfs_io() does the work.
  */
@@ -1013,6 +2136,18 @@ sfs_gettype(struct vnode *v, u_int32_t *ret)
 	return EINVAL;
 }
 
+/*
+ * Called for poll(). Files and directories never make you wait.
+ */
+static
+int
+sfs_poll(struct vnode *v, int events, int *revents)
+{
+	(void)v;
+	*revents = events;
+	return 0;
+}
+
 /*
  * Check for legal seeks on files. Allow anything non-negative.
  * We could conceivably, here, prohibit seeking past the maximum
@@ -1035,15 +2170,120 @@ sfs_tryseek(struct vnode *v, off_t pos)
 }
 
 /*
- * Called for fsync(), and also on filesystem unmount, global sync(),
- * and some other cases.
+ * Write out the cached blocks among the N block numbers in BLOCKS
+ * (zeros are skipped), a run of consecutive ones at a time.
+ */
+static
+int
+sfs_fsync_blocks(struct sfs_fs *sfs, const u_int32_t *blocks, unsigned n)
+{
+	unsigned i, run;
+	int result;
+
+	for (i=0; i<n; i += run) {
+		run = 1;
+		if (blocks[i] == 0) {
+			continue;
+		}
+		while (i+run < n && blocks[i+run] == blocks[i]+run) {
+			run++;
+		}
+		result = buf_syncrange(sfs->sfs_device, blocks[i], run);
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Write out the cached blocks under indirect block IDBLOCK, which has
+ * LEVEL levels of indirection, and then IDBLOCK itself.
+ */
+static
+int
+sfs_fsync_tree(struct sfs_fs *sfs, u_int32_t idblock, int level)
+{
+	struct buf *b;
+	u_int32_t *idbuf;
+	int j, result;
+
+	result = buf_read(sfs->sfs_device, idblock, &b);
+	if (result) {
+		return result;
+	}
+	idbuf = b->b_data;
+
+	if (level == 1) {
+		result = sfs_fsync_blocks(sfs, idbuf, SFS_DBPERIDB);
+	}
+	else {
+		for (j=0; j<SFS_DBPERIDB && result==0; j++) {
+			if (idbuf[j] != 0) {
+				result = sfs_fsync_tree(sfs, idbuf[j], level-1);
+			}
+		}
+	}
+	buf_release(b);
+	if (result) {
+		return result;
+	}
+
+	return buf_syncrange(sfs->sfs_device, idblock, 1);
+}
+
+/*
+ * Called for fsync(). Writes the file's dirty blocks, then its inode,
+ * all the way to disk. (Syncing the whole filesystem, which writes
+ * out everything at once, is sfs_sync.)
  */
 static
 int
 sfs_fsync(struct vnode *v)
 {
 	struct sfs_vnode *sv = v->vn_data;
-	return sfs_sync_inode(sv);
+	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
+	struct sfs_xinode *sxi;
+	u_int32_t i;
+	int level, result;
+
+	if (SFS_EXTENTS(sfs)) {
+		sxi = SFS_XINODE(sv);
+		for (i=0; i<sxi->sxi_nextents; i++) {
+			if (sxi->sxi_extents[i].sx_start == 0) {
+				continue;
+			}
+			result = buf_syncrange(sfs->sfs_device,
+					       sxi->sxi_extents[i].sx_start,
+					       sxi->sxi_extents[i].sx_len);
+			if (result) {
+				return result;
+			}
+		}
+	}
+	else {
+		result = sfs_fsync_blocks(sfs, sv->sv_i.sfi_direct,
+					  SFS_NDIRECT);
+		if (result) {
+			return result;
+		}
+		for (level=1; level<=SFS_NIDLEVELS; level++) {
+			if (*sfs_idroot(sv, level) == 0) {
+				continue;
+			}
+			result = sfs_fsync_tree(sfs, *sfs_idroot(sv, level),
+						level);
+			if (result) {
+				return result;
+			}
+		}
+	}
+
+	result = sfs_sync_inode(sv);
+	if (result) {
+		return result;
+	}
+	return buf_syncrange(sfs->sfs_device, sv->sv_ino, 1);
 }
 
 /*
@@ -1064,27 +2304,23 @@ static
 int
 sfs_truncate(struct vnode *v, off_t len)
 {
-	/*
-	 * I/O buffer for handling the indirect block.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static u_int32_t idbuf[SFS_DBPERIDB];
-
 	struct sfs_vnode *sv = v->vn_data;
 	struct sfs_fs *sfs = sv->sv_v.vn_fs->fs_data;
 
 	/* Length in blocks (divide rounding up) */
 	u_int32_t blocklen = DIVROUNDUP(len, SFS_BLOCKSIZE);
 
-	u_int32_t i, j, block;
-	u_int32_t idblock, baseblock, highblock;
-	int result;
-	int hasnonzero, iddirty;
+	u_int32_t i, block;
+	u_int32_t idblock, baseblock, span;
+	int level, result, empty;
 
-	assert(sizeof(idbuf)==SFS_BLOCKSIZE);
+	/* Nothing should be set aside past the new end of file */
+	sfs_unreserve(sv);
+
+	if (SFS_EXTENTS(sfs)) {
+		sfs_xtruncate(sv, blocklen);
+		goto done;
+	}
 
 	/*
 	 * Go through the direct blocks. Discard any that are
@@ -1095,63 +2331,43 @@ sfs_truncate(struct vnode *v, off_t len)
 		if (i >= blocklen && block != 0) {
 			sfs_bfree(sfs, block);
 			sv->sv_i.sfi_direct[i] = 0;
-			sv->sv_dirty = 1;
+			sfs_dirty(sv);
 		}
 	}
 
-	/* Indirect block number */
-	idblock = sv->sv_i.sfi_indirect;
+	/* The last-level indirect block we remember may be going away */
+	sv->sv_idblock = 0;
 
-	/* The lowest block in the indirect block */
+	/*
+	 * Go through the indirect trees, freeing the parts past the new
+	 * end of file. BASEBLOCK is the first file block each maps, and
+	 * SPAN the number of blocks it maps.
+	 */
 	baseblock = SFS_NDIRECT;
-
-	/* The highest block in the indirect block */
-	highblock = baseblock + SFS_DBPERIDB - 1;
-
-	if (blocklen < highblock && idblock != 0) {
-		/* We're past the proposed EOF; may need to free stuff */
-
-		/* Read the indirect block */
-		result = sfs_rblock(sfs, idbuf, idblock);
-		if (result) {
-			return result;
-		}
-		
-		hasnonzero = 0;
-		iddirty = 0;
-		for (j=0; j<SFS_DBPERIDB; j++) {
-			/* Discard any blocks that are past the new EOF */
-			if (blocklen < baseblock+j && idbuf[j] != 0) {
-				sfs_bfree(sfs, idbuf[j]);
-				idbuf[j] = 0;
-				iddirty = 1;
-			}
-			/* Remember if we see any nonzero blocks in here */
-			if (idbuf[j]!=0) {
-				hasnonzero=1;
-			}
-		}
-
-		if (!hasnonzero) {
-			/* The whole indirect block is empty now; free it */
-			sfs_bfree(sfs, idblock);
-			sv->sv_i.sfi_indirect = 0;
-			sv->sv_dirty = 1;
-		}
-		else if (iddirty) {
-			/* The indirect block is dirty; write it back */
-			result = sfs_wblock(sfs, idbuf, idblock);
+	span = SFS_DBPERIDB;
+	for (level=1; level<=SFS_NIDLEVELS; level++) {
+		idblock = *sfs_idroot(sv, level);
+		if (idblock != 0 && blocklen < baseblock + span) {
+			result = sfs_truncate_tree(sfs, idblock, level,
+						   baseblock, blocklen, &empty);
 			if (result) {
 				return result;
 			}
+			if (empty) {
+				*sfs_idroot(sv, level) = 0;
+				sfs_dirty(sv);
+			}
 		}
+		baseblock += span;
+		span *= SFS_DBPERIDB;
 	}
 
+ done:
 	/* Set the file size */
 	sv->sv_i.sfi_size = len;
 
 	/* Mark the inode dirty */
-	sv->sv_dirty = 1;
+	sfs_dirty(sv);
 	
 	return 0;
 }
@@ -1224,11 +2440,17 @@ sfs_creat(struct vnode *v, const char *name, int excl, struct vnode **ret)
 		return result;
 	}
 
+	/*
+	 * Forget that it didn't exist. Not until now: a lookup while
+	 * we slept above could have cached that again.
+	 */
+	dcache_remove(v, name);
+
 	/* Update the linkcount of the new file */
 	newguy->sv_i.sfi_linkcount++;
 
 	/* and consequently mark it dirty. */
-	newguy->sv_dirty = 1;
+	sfs_dirty(newguy);
 
 	*ret = &newguy->sv_v;
 	
@@ -1256,9 +2478,12 @@ sfs_link(struct vnode *dir, const char *name, struct vnode *file)
 		return result;
 	}
 
+	/* The name may be cached as not existing */
+	dcache_remove(dir, name);
+
 	/* and update the link count, marking the inode dirty */
 	f->sv_i.sfi_linkcount++;
-	f->sv_dirty = 1;
+	sfs_dirty(f);
 
 	return 0;
 }
@@ -1275,6 +2500,9 @@ sfs_remove(struct vnode *dir, const char *name)
 	int slot;
 	int result;
 
+	/* Drop the name cache's hold on it first */
+	dcache_remove(dir, name);
+
 	/* Look for the file and fetch a vnode for it. */
 	result = sfs_lookonce(sv, name, &victim, &slot);
 	if (result) {
@@ -1287,7 +2515,10 @@ sfs_remove(struct vnode *dir, const char *name)
 		/* If we succeeded, decrement the link count. */
 		assert(victim->sv_i.sfi_linkcount > 0);
 		victim->sv_i.sfi_linkcount--;
-		victim->sv_dirty = 1;
+		sfs_dirty(victim);
+
+		/* A lookup while we slept may have cached it again */
+		dcache_remove(dir, name);
 	}
 
 	/* Discard the reference that sfs_lookonce got us */
@@ -1307,6 +2538,7 @@ int
 sfs_rename(struct vnode *d1, const char *n1, 
 	   struct vnode *d2, const char *n2)
 {
+	struct sfs_fs *sfs = d1->vn_fs->fs_data;
 	struct sfs_vnode *sv = d1->vn_data;
 	struct sfs_vnode *g1;
 	int slot1, slot2;
@@ -1339,7 +2571,18 @@ sfs_rename(struct vnode *d1, const char *n1,
 	
 	/* Increment the link count, and mark inode dirty */
 	g1->sv_i.sfi_linkcount++;
-	g1->sv_dirty = 1;
+	sfs_dirty(g1);
+
+	/*
+	 * Adding a name to a hashed directory may have moved the old
+	 * entry to another bucket; find it again.
+	 */
+	if (SFS_HASHDIRS(sfs)) {
+		result = sfs_dir_findname(sv, n1, NULL, &slot1, NULL);
+		if (result) {
+			goto puke_harder;
+		}
+	}
 
 	/* Unlink the old slot */
 	result = sfs_dir_unlink(sv, slot1);
@@ -1353,7 +2596,11 @@ sfs_rename(struct vnode *d1, const char *n1,
 	 */
 	assert(g1->sv_i.sfi_linkcount>0);
 	g1->sv_i.sfi_linkcount--;
-	g1->sv_dirty = 1;
+	sfs_dirty(g1);
+
+	/* Both names have changed meaning */
+	dcache_remove(d1, n1);
+	dcache_remove(d2, n2);
 
 	/* Let go of the reference to g1 */
 	VOP_DECREF(&g1->sv_v);
@@ -1372,6 +2619,9 @@ sfs_rename(struct vnode *d1, const char *n1,
 		panic("sfs: rename: Cannot recover\n");
 	}
 	g1->sv_i.sfi_linkcount--;
+
+	/* N2 existed for a while; a lookup may have cached it */
+	dcache_remove(d2, n2);
  puke:
 	/* Let go of the reference to g1 */
 	VOP_DECREF(&g1->sv_v);
@@ -1419,16 +2669,30 @@ sfs_lookup(struct vnode *v, char *path, struct vnode **ret)
 {
 	struct sfs_vnode *sv = v->vn_data;
 	struct sfs_vnode *final;
+	struct vnode *vn;
 	int result;
 
 	if (sv->sv_i.sfi_type != SFS_TYPE_DIR) {
 		return ENOTDIR;
 	}
+
+	/* Try the name cache before reading the directory */
+	if (dcache_lookup(v, path, &vn)) {
+		if (vn == NULL) {
+			return ENOENT;
+		}
+		*ret = vn;
+		return 0;
+	}
 	
 	result = sfs_lookonce(sv, path, &final, NULL);
+	if (result == ENOENT) {
+		dcache_enter(v, path, NULL);
+	}
 	if (result) {
 		return result;
 	}
+	dcache_enter(v, path, &final->sv_v);
 
 	*ret = &final->sv_v;
 
@@ -1481,10 +2745,12 @@ static const struct vnode_ops sfs_fileops = {
 	sfs_read,
 	NOTDIR,  /* readlink */
 	NOTDIR,  /* getdirentry */
+	NOTDIR,  /* getdirentries */
 	sfs_write,
 	sfs_ioctl,
 	sfs_stat,
 	sfs_gettype,
+	sfs_poll,
 	sfs_tryseek,
 	sfs_fsync,
 	sfs_mmap,
@@ -1515,11 +2781,13 @@ static const struct vnode_ops sfs_dirops = {
 	
 	ISDIR,   /* read */
 	ISDIR,   /* readlink */
-	UNIMP,   /* getdirentry */
+	sfs_getdirentry,
+	sfs_getdirentries,
 	ISDIR,   /* write */
 	sfs_ioctl,
 	sfs_stat,
 	sfs_gettype,
+	sfs_poll,
 	UNIMP,   /* tryseek */
 	sfs_fsync,
 	ISDIR,   /* mmap */
@@ -1549,25 +2817,21 @@ sfs_loadvnode(struct sfs_fs *sfs, u_int32_t ino, int forcetype,
 {
 	struct sfs_vnode *sv;
 	const struct vnode_ops *ops = NULL;
-	int i, num;
 	int result;
 
 	/* Look in the vnodes table */
-	num = array_getnum(sfs->sfs_vnodes);
-
-	/* Linear search. Is this too slow? You decide. */
-	for (i=0; i<num; i++) {
-		sv = array_getguy(sfs->sfs_vnodes, i);
-
-		/* Every inode in memory must be in an allocated block */
-		if (!sfs_bused(sfs, sv->sv_ino)) {
-			panic("sfs: Found inode %u in unallocated block\n",
-			      sv->sv_ino);
-		}
+	for (sv = sfs->sfs_vnhash[SFS_VNHASH(ino)]; sv != NULL;
+	     sv = sv->sv_hashnext) {
 
 		if (sv->sv_ino==ino) {
 			/* Found */
 
+			/* Every inode in memory must be in an allocated block */
+			if (!sfs_bused(sfs, sv->sv_ino)) {
+				panic("sfs: Found inode %u in unallocated "
+				      "block\n", sv->sv_ino);
+			}
+
 			/* May only be set when creating new objects */
 			assert(forcetype==SFS_TYPE_INVAL);
 
@@ -1599,16 +2863,22 @@ sfs_loadvnode(struct sfs_fs *sfs, u_int32_t ino, int forcetype,
 
 	/* Not dirty yet */
 	sv->sv_dirty = 0;
+	sv->sv_dirtyprev = sv->sv_dirtynext = NULL;
+
+	/* No blocks set aside */
+	sv->sv_rsvstart = sv->sv_rsvcount = 0;
+	sv->sv_idblock = 0;
+	sv->sv_ranext = sv->sv_rawindow = sv->sv_raend = 0;
 
 	/*
 	 * FORCETYPE is set if we're creating a new file, because the
 	 * block on disk will have been zeroed out and thus the type
-	 * recorded there will be SFS_TYPE_INVAL.
+	 * recorded there will be SFS_TYPE_INVAL. (It gets marked dirty
+	 * once the vnode is set up, below.)
 	 */
 	if (forcetype != SFS_TYPE_INVAL) {
 		assert(sv->sv_i.sfi_type == SFS_TYPE_INVAL);
 		sv->sv_i.sfi_type = forcetype;
-		sv->sv_dirty = 1;
 	}
 
 	/*
@@ -1638,11 +2908,12 @@ sfs_loadvnode(struct sfs_fs *sfs, u_int32_t ino, int forcetype,
 	sv->sv_ino = ino;
 
 	/* Add it to our table */
-	result = array_add(sfs->sfs_vnodes, sv);
-	if (result) {
-		VOP_KILL(&sv->sv_v);
-		kfree(sv);
-		return result;
+	sv->sv_hashnext = sfs->sfs_vnhash[SFS_VNHASH(ino)];
+	sfs->sfs_vnhash[SFS_VNHASH(ino)] = sv;
+	sfs->sfs_nvnodes++;
+
+	if (forcetype != SFS_TYPE_INVAL) {
+		sfs_dirty(sv);
 	}
 
 	/* Hand it back */
@@ -0,0 +1,1127 @@
+/*
+ * Block buffer cache. See buf.h.
+ *
+ * Buffers are found through a hash table on (device, block) and kept
+ * on a single LRU list, most recently used at the head. buf_lock
+ * protects both, along with the flags in every buffer. Disk I/O is
+ * done without buf_lock held; the buffer is marked busy instead, and
+ * anybody else who wants it waits on buf_cv.
+ *
+ * Buffers are allocated as needed up to BUF_NBUFS. After that a miss
+ * takes the least recently used buffer that isn't held, writing it
+ * out first if it is dirty.
+ *
+ * Read-ahead requests are queued for a kernel thread, buf_rathread,
+ * which holds the buffers it is filling busy; a reader that gets
+ * there first waits for the read to finish just as for any other
+ * busy buffer.
+ *
+ * Another thread, buf_syncer, writes back buffers that have been
+ * dirty longer than BUF_MAXAGE seconds, and the oldest ones whenever
+ * more than BUF_DIRTYHIGH buffers are dirty. Flushes go out sorted by
+ * block number (see buf_flush).
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <thread.h>
+#include <clock.h>
+#include <machine/spl.h>
+#include <uio.h>
+#include <dev.h>
+#include <buf.h>
+
+#define BUF_HASHSIZE  67
+
+static struct lock *buf_lock;
+static struct cv *buf_cv;
+
+static struct buf *buf_hash[BUF_HASHSIZE];
+static struct buf *buf_lruhead;
+static struct buf *buf_lrutail;
+static int buf_count;
+static unsigned buf_ndirty;		/* number of dirty buffers */
+
+/* Write-back policy for buf_syncer */
+#define BUF_SYNCPERIOD  1		/* seconds between checks */
+#define BUF_MAXAGE      5		/* seconds a buffer may stay dirty */
+#define BUF_DIRTYHIGH   (BUF_NBUFS/2)	/* more dirty than this... */
+#define BUF_DIRTYLOW    (BUF_NBUFS/4)	/* ...and flush down to this */
+
+/*
+ * Blocks picked to be written by buf_flush. Flushes are one at a time
+ * (buf_flushlock) so this needn't be on the stack.
+ */
+struct buf_flushent {
+	struct device *fe_dev;
+	u_int32_t fe_block;
+	time_t fe_time;
+};
+
+static struct lock *buf_flushlock;
+static struct buf_flushent buf_flushlist[BUF_NBUFS];
+
+/* Read-ahead requests waiting for buf_rathread; a circular queue */
+#define BUF_RAQUEUE  16
+
+struct buf_rareq {
+	struct device *ra_dev;
+	u_int32_t ra_block;
+	u_int32_t ra_nblocks;
+};
+
+static struct cv *buf_racv;
+static struct buf_rareq buf_raqueue[BUF_RAQUEUE];
+static unsigned buf_rafirst;		/* oldest request */
+static unsigned buf_racount;		/* number of requests */
+static struct device *buf_radev;	/* device being read ahead, if any */
+
+/* Statistics */
+static u_int32_t buf_hits;		/* found in the cache */
+static u_int32_t buf_misses;		/* not found */
+static u_int32_t buf_diskreads;		/* blocks read from disk */
+static u_int32_t buf_diskwrites;	/* blocks written to disk */
+static u_int32_t buf_writereqs;		/* ...in this many requests */
+static u_int32_t buf_evictions;		/* buffers reused for another block */
+static u_int32_t buf_directreqs;	/* buf_directio requests */
+static u_int32_t buf_directblocks;	/* blocks moved by buf_directio */
+static u_int32_t buf_rareqs;		/* read-ahead requests taken */
+static u_int32_t buf_radropped;		/* ...dropped, queue full */
+static u_int32_t buf_rablocks;		/* blocks read ahead */
+static u_int32_t buf_syncerruns;	/* times buf_syncer flushed */
+
+static void buf_rathread(void *, unsigned long);
+static void buf_syncer(void *, unsigned long);
+
+void
+buf_bootstrap(void)
+{
+	int result;
+
+	buf_lock = lock_create("buf");
+	if (buf_lock == NULL) {
+		panic("buf: Could not create lock\n");
+	}
+	buf_cv = cv_create("buf");
+	if (buf_cv == NULL) {
+		panic("buf: Could not create cv\n");
+	}
+	buf_racv = cv_create("bufra");
+	if (buf_racv == NULL) {
+		panic("buf: Could not create cv\n");
+	}
+	buf_flushlock = lock_create("bufflush");
+	if (buf_flushlock == NULL) {
+		panic("buf: Could not create lock\n");
+	}
+
+	result = thread_fork("bufra", NULL, 0, buf_rathread, NULL);
+	if (result) {
+		panic("buf: Could not start read-ahead thread: %s\n",
+		      strerror(result));
+	}
+	result = thread_fork("bufsync", NULL, 0, buf_syncer, NULL);
+	if (result) {
+		panic("buf: Could not start syncer thread: %s\n",
+		      strerror(result));
+	}
+}
+
+////////////////////////////////////////////////////////////
+//
+// Hash table and LRU list. Must hold buf_lock.
+
+static
+unsigned
+buf_hashfn(struct device *dev, u_int32_t block)
+{
+	return (((u_int32_t)dev >> 4) ^ block) % BUF_HASHSIZE;
+}
+
+static
+struct buf *
+buf_lookup(struct device *dev, u_int32_t block)
+{
+	struct buf *b;
+
+	for (b = buf_hash[buf_hashfn(dev, block)]; b != NULL; b = b->b_hashnext) {
+		if (b->b_dev == dev && b->b_block == block) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+static
+void
+buf_hashinsert(struct buf *b)
+{
+	unsigned h = buf_hashfn(b->b_dev, b->b_block);
+
+	b->b_hashnext = buf_hash[h];
+	buf_hash[h] = b;
+}
+
+static
+void
+buf_hashremove(struct buf *b)
+{
+	struct buf **pp;
+
+	pp = &buf_hash[buf_hashfn(b->b_dev, b->b_block)];
+	while (*pp != b) {
+		assert(*pp != NULL);
+		pp = &(*pp)->b_hashnext;
+	}
+	*pp = b->b_hashnext;
+	b->b_hashnext = NULL;
+}
+
+static
+void
+buf_lruremove(struct buf *b)
+{
+	if (b->b_lruprev != NULL) {
+		b->b_lruprev->b_lrunext = b->b_lrunext;
+	}
+	else {
+		buf_lruhead = b->b_lrunext;
+	}
+	if (b->b_lrunext != NULL) {
+		b->b_lrunext->b_lruprev = b->b_lruprev;
+	}
+	else {
+		buf_lrutail = b->b_lruprev;
+	}
+	b->b_lruprev = b->b_lrunext = NULL;
+}
+
+static
+void
+buf_lruinsert_head(struct buf *b)
+{
+	b->b_lruprev = NULL;
+	b->b_lrunext = buf_lruhead;
+	if (buf_lruhead != NULL) {
+		buf_lruhead->b_lruprev = b;
+	}
+	else {
+		buf_lrutail = b;
+	}
+	buf_lruhead = b;
+}
+
+static
+void
+buf_lruinsert_tail(struct buf *b)
+{
+	b->b_lrunext = NULL;
+	b->b_lruprev = buf_lrutail;
+	if (buf_lrutail != NULL) {
+		buf_lrutail->b_lrunext = b;
+	}
+	else {
+		buf_lruhead = b;
+	}
+	buf_lrutail = b;
+}
+
+/*
+ * Take a buffer out of the cache, so it holds no block.
+ */
+static
+void
+buf_forget(struct buf *b)
+{
+	if (b->b_dev != NULL) {
+		buf_hashremove(b);
+	}
+	if (b->b_dirty) {
+		buf_ndirty--;
+	}
+	b->b_dev = NULL;
+	b->b_valid = 0;
+	b->b_dirty = 0;
+}
+
+////////////////////////////////////////////////////////////
+//
+// Disk I/O
+
+/*
+ * Hand a request to the device, retrying I/O errors a few times.
+ * A retry starts the whole request over. uiomove advances the iovecs
+ * UIO points to in place, so those are saved in IOVSAVE (room for
+ * uio_iovcnt entries, supplied by the caller) and put back along with
+ * the uio itself before each retry.
+ */
+static
+int
+buf_rawio(struct device *dev, struct uio *uio, struct iovec *iovsave)
+{
+	struct uio save = *uio;
+	u_int32_t block = uio->uio_offset / BUF_BLOCKSIZE;
+	int i, result;
+	int tries=0;
+
+	for (i=0; i<uio->uio_iovcnt; i++) {
+		iovsave[i] = uio->uio_iov[i];
+	}
+
+ retry:
+	result = dev->d_io(dev, uio);
+	if (result == EINVAL) {
+		/*
+		 * This means the sector we requested was out of range,
+		 * or the seek address we gave wasn't sector-aligned,
+		 * or a couple of other things that are our fault.
+		 */
+		panic("buf: d_io returned EINVAL\n");
+	}
+	if (result == EIO) {
+		if (tries == 0) {
+			tries++;
+			kprintf("buf: block %u I/O error, retrying\n", block);
+			goto restart;
+		}
+		else if (tries < 10) {
+			tries++;
+			goto restart;
+		}
+		else {
+			kprintf("buf: block %u I/O error, giving up after "
+				"%d retries\n", block, tries);
+		}
+	}
+	return result;
+
+ restart:
+	*uio = save;
+	for (i=0; i<uio->uio_iovcnt; i++) {
+		uio->uio_iov[i] = iovsave[i];
+	}
+	goto retry;
+}
+
+/*
+ * Read or write a buffer's block. Called with the buffer busy and
+ * buf_lock not held.
+ */
+static
+int
+buf_devio(struct buf *b, enum uio_rw rw)
+{
+	struct uio ku;
+	struct iovec iovsave;
+
+	DEBUG(DB_SFS, "buf: %s %u\n",
+	      rw == UIO_READ ? "read" : "write", b->b_block);
+
+	if (rw == UIO_READ) {
+		buf_diskreads++;
+	}
+	else {
+		buf_diskwrites++;
+	}
+
+	mk_kuio(&ku, b->b_data, BUF_BLOCKSIZE,
+		((off_t)b->b_block)*BUF_BLOCKSIZE, rw);
+	return buf_rawio(b->b_dev, &ku, &iovsave);
+}
+
+/*
+ * Write out a dirty buffer that nobody holds. Dirty buffers nobody
+ * holds for the blocks around it go along too, up to BUF_CLUSTER
+ * blocks in all, in a single device request. Must hold buf_lock,
+ * which is dropped during the I/O; anything might have changed by the
+ * time this returns.
+ */
+static
+int
+buf_writeback(struct buf *b)
+{
+	struct buf *bufs[BUF_CLUSTER];
+	struct iovec iov[BUF_CLUSTER], iovsave[BUF_CLUSTER];
+	struct device *dev = b->b_dev;
+	struct buf *nb;
+	struct uio ku;
+	u_int32_t first, i, n;
+	int result;
+
+	assert(b->b_dirty && !b->b_busy);
+
+	/* Back up over dirty blocks before it, up to half a cluster */
+	first = b->b_block;
+	for (i=1; i<BUF_CLUSTER/2 && first > 0; i++) {
+		nb = buf_lookup(dev, first-1);
+		if (nb == NULL || !nb->b_dirty || nb->b_busy) {
+			break;
+		}
+		first--;
+	}
+
+	/* Take the dirty blocks from there on */
+	for (n=0; n<BUF_CLUSTER; n++) {
+		nb = buf_lookup(dev, first+n);
+		if (nb == NULL || !nb->b_dirty || nb->b_busy) {
+			break;
+		}
+		nb->b_busy = 1;
+		bufs[n] = nb;
+		iov[n].iov_kbase = nb->b_data;
+		iov[n].iov_len = BUF_BLOCKSIZE;
+	}
+	assert(b->b_busy);
+
+	buf_diskwrites += n;
+	buf_writereqs++;
+	lock_release(buf_lock);
+
+	DEBUG(DB_SFS, "buf: write %u-%u\n", first, first + n - 1);
+
+	ku.uio_iov = iov;
+	ku.uio_iovcnt = n;
+	ku.uio_offset = ((off_t)first) * BUF_BLOCKSIZE;
+	ku.uio_resid = n * BUF_BLOCKSIZE;
+	ku.uio_segflg = UIO_SYSSPACE;
+	ku.uio_rw = UIO_WRITE;
+	ku.uio_space = NULL;
+	result = buf_rawio(dev, &ku, iovsave);
+
+	lock_acquire(buf_lock);
+	for (i=0; i<n; i++) {
+		bufs[i]->b_busy = 0;
+		if (result == 0) {
+			bufs[i]->b_dirty = 0;
+			buf_ndirty--;
+		}
+	}
+	cv_broadcast(buf_cv, buf_lock);
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+//
+// Getting buffers
+
+/*
+ * Find a buffer to put a new block in: a fresh one if we haven't made
+ * them all yet, otherwise the least recently used one nobody holds.
+ * Returns NULL if every buffer is held. Must hold buf_lock.
+ */
+static
+struct buf *
+buf_victim(void)
+{
+	struct buf *b;
+
+	if (buf_count < BUF_NBUFS) {
+		b = kmalloc(sizeof(struct buf));
+		if (b != NULL) {
+			b->b_data = kmalloc(BUF_BLOCKSIZE);
+			if (b->b_data == NULL) {
+				kfree(b);
+				b = NULL;
+			}
+		}
+		if (b != NULL) {
+			b->b_dev = NULL;
+			b->b_block = 0;
+			b->b_valid = b->b_dirty = b->b_busy = 0;
+			b->b_hashnext = NULL;
+			buf_lruinsert_tail(b);
+			buf_count++;
+			return b;
+		}
+		/* Out of memory; make do with what we have */
+	}
+
+	for (b = buf_lrutail; b != NULL; b = b->b_lruprev) {
+		if (!b->b_busy) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Get and hold the buffer for BLOCK on DEV. Its contents are only
+ * meaningful if b_valid is set.
+ */
+static
+int
+buf_acquire(struct device *dev, u_int32_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	assert(dev->d_blocksize == BUF_BLOCKSIZE);
+
+	lock_acquire(buf_lock);
+	while (1) {
+		b = buf_lookup(dev, block);
+		if (b != NULL) {
+			if (b->b_busy) {
+				cv_wait(buf_cv, buf_lock);
+				continue;
+			}
+			buf_hits++;
+			break;
+		}
+
+		b = buf_victim();
+		if (b == NULL) {
+			/* Everything is held; wait for a release */
+			cv_wait(buf_cv, buf_lock);
+			continue;
+		}
+
+		if (b->b_dirty) {
+			/* Clean it, then look again from the top */
+			result = buf_writeback(b);
+			if (result) {
+				lock_release(buf_lock);
+				return result;
+			}
+			continue;
+		}
+
+		if (b->b_dev != NULL) {
+			buf_evictions++;
+		}
+		buf_forget(b);
+		b->b_dev = dev;
+		b->b_block = block;
+		buf_hashinsert(b);
+		buf_misses++;
+		break;
+	}
+
+	b->b_busy = 1;
+	buf_lruremove(b);
+	buf_lruinsert_head(b);
+	lock_release(buf_lock);
+
+	*ret = b;
+	return 0;
+}
+
+int
+buf_read(struct device *dev, u_int32_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	result = buf_acquire(dev, block, &b);
+	if (result) {
+		return result;
+	}
+
+	if (!b->b_valid) {
+		result = buf_devio(b, UIO_READ);
+		if (result) {
+			lock_acquire(buf_lock);
+			buf_forget(b);
+			b->b_busy = 0;
+			cv_broadcast(buf_cv, buf_lock);
+			lock_release(buf_lock);
+			return result;
+		}
+		b->b_valid = 1;
+	}
+
+	*ret = b;
+	return 0;
+}
+
+int
+buf_get(struct device *dev, u_int32_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	result = buf_acquire(dev, block, &b);
+	if (result) {
+		return result;
+	}
+
+	if (!b->b_valid) {
+		/* Don't leave some other block's data lying around */
+		bzero(b->b_data, BUF_BLOCKSIZE);
+		b->b_valid = 1;
+	}
+
+	*ret = b;
+	return 0;
+}
+
+void
+buf_markdirty(struct buf *b)
+{
+	u_int32_t nsecs;
+	int spl;
+
+	assert(b->b_busy);
+	if (b->b_dirty) {
+		return;
+	}
+
+	lock_acquire(buf_lock);
+	b->b_dirty = 1;
+	gettime(&b->b_dirtytime, &nsecs);
+	buf_ndirty++;
+	if (buf_ndirty > BUF_DIRTYHIGH) {
+		/* Too much dirty; get the syncer going now */
+		spl = splhigh();
+		thread_wakeup(&buf_ndirty);
+		splx(spl);
+	}
+	lock_release(buf_lock);
+}
+
+void
+buf_release(struct buf *b)
+{
+	lock_acquire(buf_lock);
+	assert(b->b_busy);
+	b->b_busy = 0;
+	cv_broadcast(buf_cv, buf_lock);
+	lock_release(buf_lock);
+}
+
+void
+buf_invalidate(struct buf *b)
+{
+	lock_acquire(buf_lock);
+	assert(b->b_busy);
+	if (!b->b_dirty) {
+		/* The disk still has the real contents; reread them */
+		buf_forget(b);
+		buf_lruremove(b);
+		buf_lruinsert_tail(b);
+	}
+	b->b_busy = 0;
+	cv_broadcast(buf_cv, buf_lock);
+	lock_release(buf_lock);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Direct I/O
+
+/*
+ * Write out dirty cached copies of a range of blocks, so a direct read
+ * of them sees what the cache does.
+ */
+static
+int
+buf_directflush(struct device *dev, u_int32_t block, u_int32_t nblocks)
+{
+	struct buf *b;
+	u_int32_t i;
+	int result;
+
+	lock_acquire(buf_lock);
+	for (i=0; i<nblocks; i++) {
+		b = buf_lookup(dev, block+i);
+		while (b != NULL && b->b_busy) {
+			cv_wait(buf_cv, buf_lock);
+			b = buf_lookup(dev, block+i);
+		}
+		if (b != NULL && b->b_dirty) {
+			result = buf_writeback(b);
+			if (result) {
+				lock_release(buf_lock);
+				return result;
+			}
+		}
+	}
+	lock_release(buf_lock);
+	return 0;
+}
+
+int
+buf_directio(struct device *dev, u_int32_t block, u_int32_t nblocks,
+	     struct uio *uio)
+{
+	off_t saveoff, diskoff;
+	size_t saveres, diskres;
+	struct iovec oneiov, *iovsave;
+	int result;
+
+	assert(dev->d_blocksize == BUF_BLOCKSIZE);
+	assert(uio->uio_rw == UIO_READ);
+	assert(uio->uio_resid >= nblocks * BUF_BLOCKSIZE);
+
+	/* Room for buf_rawio to save the caller's iovecs */
+	if (uio->uio_iovcnt == 1) {
+		iovsave = &oneiov;
+	}
+	else {
+		iovsave = kmalloc(uio->uio_iovcnt * sizeof(struct iovec));
+		if (iovsave == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	result = buf_directflush(dev, block, nblocks);
+	if (result) {
+		goto done;
+	}
+
+	DEBUG(DB_SFS, "buf: direct read %u-%u\n", block, block + nblocks - 1);
+
+	buf_directreqs++;
+	buf_directblocks += nblocks;
+
+	/*
+	 * Substitute an offset and residue that make sense to the
+	 * device, then put back the caller's, updated by the amount of
+	 * I/O done.
+	 */
+	saveoff = uio->uio_offset;
+	saveres = uio->uio_resid;
+	diskoff = ((off_t)block) * BUF_BLOCKSIZE;
+	diskres = nblocks * BUF_BLOCKSIZE;
+	uio->uio_offset = diskoff;
+	uio->uio_resid = diskres;
+
+	result = buf_rawio(dev, uio, iovsave);
+
+	uio->uio_offset = (uio->uio_offset - diskoff) + saveoff;
+	uio->uio_resid = (uio->uio_resid - diskres) + saveres;
+
+ done:
+	if (iovsave != &oneiov) {
+		kfree(iovsave);
+	}
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+//
+// Read-ahead
+
+/*
+ * Read blocks BLOCK.. on DEV into the cache, up to NBLOCKS of them
+ * and BUF_RAMAX at a time, with one device request per batch. Stops
+ * at the first block that is already cached (or being read), or when
+ * no clean buffer is free; read-ahead never waits for anything but
+ * its own I/O. Returns the number of blocks it got through.
+ */
+static
+u_int32_t
+buf_prefetch(struct device *dev, u_int32_t block, u_int32_t nblocks)
+{
+	/* Only buf_rathread gets here, so these needn't be on the stack */
+	static struct buf *bufs[BUF_RAMAX];
+	static struct iovec iov[BUF_RAMAX], iovsave[BUF_RAMAX];
+
+	struct buf *b;
+	struct uio ku;
+	u_int32_t i, n;
+	int result;
+
+	if (nblocks > BUF_RAMAX) {
+		nblocks = BUF_RAMAX;
+	}
+
+	lock_acquire(buf_lock);
+	for (n=0; n<nblocks; n++) {
+		if (buf_lookup(dev, block+n) != NULL) {
+			break;
+		}
+		b = buf_victim();
+		if (b == NULL || b->b_dirty) {
+			break;
+		}
+
+		if (b->b_dev != NULL) {
+			buf_evictions++;
+		}
+		buf_forget(b);
+		b->b_dev = dev;
+		b->b_block = block+n;
+		buf_hashinsert(b);
+		b->b_busy = 1;
+		buf_lruremove(b);
+		buf_lruinsert_head(b);
+
+		bufs[n] = b;
+		iov[n].iov_kbase = b->b_data;
+		iov[n].iov_len = BUF_BLOCKSIZE;
+	}
+	lock_release(buf_lock);
+
+	if (n == 0) {
+		return 0;
+	}
+
+	DEBUG(DB_SFS, "buf: read ahead %u-%u\n", block, block + n - 1);
+
+	ku.uio_iov = iov;
+	ku.uio_iovcnt = n;
+	ku.uio_offset = ((off_t)block) * BUF_BLOCKSIZE;
+	ku.uio_resid = n * BUF_BLOCKSIZE;
+	ku.uio_segflg = UIO_SYSSPACE;
+	ku.uio_rw = UIO_READ;
+	ku.uio_space = NULL;
+	result = buf_rawio(dev, &ku, iovsave);
+
+	lock_acquire(buf_lock);
+	buf_diskreads += n;
+	buf_rablocks += n;
+	for (i=0; i<n; i++) {
+		b = bufs[i];
+		if (result) {
+			buf_forget(b);
+		}
+		else {
+			b->b_valid = 1;
+		}
+		b->b_busy = 0;
+	}
+	cv_broadcast(buf_cv, buf_lock);
+	lock_release(buf_lock);
+
+	return n;
+}
+
+/*
+ * The read-ahead thread. Takes requests off the queue and reads them
+ * in, forever.
+ */
+static
+void
+buf_rathread(void *unused1, unsigned long unused2)
+{
+	struct buf_rareq ra;
+	u_int32_t done;
+
+	(void)unused1;
+	(void)unused2;
+
+	while (1) {
+		lock_acquire(buf_lock);
+		while (buf_racount == 0) {
+			cv_wait(buf_racv, buf_lock);
+		}
+		ra = buf_raqueue[buf_rafirst];
+		buf_rafirst = (buf_rafirst + 1) % BUF_RAQUEUE;
+		buf_racount--;
+		buf_rareqs++;
+		buf_radev = ra.ra_dev;
+		lock_release(buf_lock);
+
+		while (ra.ra_nblocks > 0) {
+			done = buf_prefetch(ra.ra_dev, ra.ra_block,
+					    ra.ra_nblocks);
+			if (done == 0) {
+				/* Skip a block that's already here */
+				done = 1;
+			}
+			ra.ra_block += done;
+			ra.ra_nblocks -= done;
+		}
+
+		lock_acquire(buf_lock);
+		buf_radev = NULL;
+		cv_broadcast(buf_cv, buf_lock);
+		lock_release(buf_lock);
+	}
+}
+
+void
+buf_readahead(struct device *dev, u_int32_t block, u_int32_t nblocks)
+{
+	struct buf_rareq *ra;
+
+	assert(dev->d_blocksize == BUF_BLOCKSIZE);
+
+	if (nblocks == 0) {
+		return;
+	}
+
+	lock_acquire(buf_lock);
+	if (buf_racount == BUF_RAQUEUE) {
+		/* It's only a hint */
+		buf_radropped++;
+	}
+	else {
+		ra = &buf_raqueue[(buf_rafirst + buf_racount) % BUF_RAQUEUE];
+		ra->ra_dev = dev;
+		ra->ra_block = block;
+		ra->ra_nblocks = nblocks;
+		buf_racount++;
+		cv_signal(buf_racv, buf_lock);
+	}
+	lock_release(buf_lock);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Writing back
+
+/*
+ * Sort the first N entries of buf_flushlist, by age if BYAGE is set,
+ * otherwise by device and block.
+ */
+static
+void
+buf_sortflush(unsigned n, int byage)
+{
+	struct buf_flushent fe;
+	unsigned i, j;
+	int before;
+
+	/* Insertion sort; the list is short and often nearly in order */
+	for (i=1; i<n; i++) {
+		fe = buf_flushlist[i];
+		for (j=i; j>0; j--) {
+			struct buf_flushent *p = &buf_flushlist[j-1];
+			if (byage) {
+				before = fe.fe_time < p->fe_time;
+			}
+			else {
+				before = fe.fe_dev < p->fe_dev ||
+					(fe.fe_dev == p->fe_dev &&
+					 fe.fe_block < p->fe_block);
+			}
+			if (!before) {
+				break;
+			}
+			buf_flushlist[j] = *p;
+		}
+		buf_flushlist[j] = fe;
+	}
+}
+
+/*
+ * Write back dirty buffers for DEV (for every device if DEV is NULL):
+ * those dirtied at or before time CUTOFF, plus as many more of the
+ * oldest as it takes to make MINIMUM. They're written in order of
+ * block number, so the disk sweeps across them once, and each write
+ * picks up its dirty neighbours (see buf_writeback). For one device
+ * (sync or unmount), held buffers are waited for, so everything dirty
+ * at the start is on disk at the end; the syncer (DEV NULL) skips
+ * them and gets them next time.
+ */
+static
+int
+buf_flush(struct device *dev, time_t cutoff, unsigned minimum)
+{
+	struct buf *b;
+	unsigned i, n, nold;
+	int result = 0;
+
+	lock_acquire(buf_flushlock);
+	lock_acquire(buf_lock);
+
+	/* Pick the buffers */
+	n = nold = 0;
+	for (b = buf_lruhead; b != NULL; b = b->b_lrunext) {
+		if (b->b_dirty && (dev == NULL || b->b_dev == dev)) {
+			buf_flushlist[n].fe_dev = b->b_dev;
+			buf_flushlist[n].fe_block = b->b_block;
+			buf_flushlist[n].fe_time = b->b_dirtytime;
+			n++;
+			if (b->b_dirtytime <= cutoff) {
+				nold++;
+			}
+		}
+	}
+	if (nold < n) {
+		/* Oldest first, then keep the ones we want */
+		buf_sortflush(n, 1);
+		if (minimum < n) {
+			n = nold > minimum ? nold : minimum;
+		}
+	}
+	buf_sortflush(n, 0);
+
+	/* Write them */
+	for (i=0; i<n; i++) {
+		b = buf_lookup(buf_flushlist[i].fe_dev,
+			       buf_flushlist[i].fe_block);
+		while (dev != NULL && b != NULL && b->b_busy) {
+			cv_wait(buf_cv, buf_lock);
+			b = buf_lookup(buf_flushlist[i].fe_dev,
+				       buf_flushlist[i].fe_block);
+		}
+		if (b != NULL && b->b_dirty && !b->b_busy) {
+			result = buf_writeback(b);
+			if (result) {
+				break;
+			}
+		}
+	}
+
+	lock_release(buf_lock);
+	lock_release(buf_flushlock);
+	return result;
+}
+
+/*
+ * The syncer thread. Every BUF_SYNCPERIOD seconds, or sooner when
+ * buf_markdirty finds too much dirty, writes back what has been dirty
+ * too long, and if there's too much dirty, the oldest of the rest.
+ */
+static
+void
+buf_syncer(void *unused1, unsigned long unused2)
+{
+	time_t now;
+	u_int32_t nsecs;
+	unsigned minimum;
+	int spl;
+
+	(void)unused1;
+	(void)unused2;
+
+	while (1) {
+		spl = splhigh();
+		thread_sleep_timeout(&buf_ndirty, BUF_SYNCPERIOD * HZ);
+		splx(spl);
+
+		if (buf_ndirty == 0) {
+			continue;
+		}
+
+		gettime(&now, &nsecs);
+		minimum = 0;
+		if (buf_ndirty > BUF_DIRTYHIGH) {
+			minimum = buf_ndirty - BUF_DIRTYLOW;
+		}
+
+		buf_syncerruns++;
+		if (buf_flush(NULL, now - BUF_MAXAGE, minimum)) {
+			/* Leave it dirty and try again next time */
+			kprintf("buf: syncer: write-back failed\n");
+		}
+	}
+}
+
+int
+buf_sync(struct device *dev)
+{
+	time_t now;
+	u_int32_t nsecs;
+
+	gettime(&now, &nsecs);
+	return buf_flush(dev, now, 0);
+}
+
+int
+buf_syncrange(struct device *dev, u_int32_t block, u_int32_t nblocks)
+{
+	struct buf *b;
+	u_int32_t i;
+	int result;
+
+	lock_acquire(buf_lock);
+	for (i=0; i<nblocks; i++) {
+		b = buf_lookup(dev, block+i);
+		if (b == NULL || !b->b_dirty) {
+			continue;
+		}
+		if (b->b_busy) {
+			/* Wait, then look at this block again */
+			cv_wait(buf_cv, buf_lock);
+			i--;
+			continue;
+		}
+		result = buf_writeback(b);
+		if (result) {
+			lock_release(buf_lock);
+			return result;
+		}
+	}
+	lock_release(buf_lock);
+	return 0;
+}
+
+int
+buf_purge(struct device *dev)
+{
+	struct buf *b, *next;
+	unsigned i;
+	int result;
+
+	/* Cancel read-ahead for DEV, and wait for any in progress */
+	lock_acquire(buf_lock);
+	for (i=0; i<buf_racount; i++) {
+		struct buf_rareq *ra;
+		ra = &buf_raqueue[(buf_rafirst + i) % BUF_RAQUEUE];
+		if (ra->ra_dev == dev) {
+			ra->ra_nblocks = 0;
+		}
+	}
+	while (buf_radev == dev) {
+		cv_wait(buf_cv, buf_lock);
+	}
+	lock_release(buf_lock);
+
+	result = buf_sync(dev);
+	if (result) {
+		return result;
+	}
+
+	/*
+	 * Someone else may still be using one of DEV's buffers, e.g.
+	 * writing it back to evict it. Wait for it; waiting drops
+	 * buf_lock, so start over afterwards.
+	 */
+	lock_acquire(buf_lock);
+ again:
+	for (b = buf_lruhead; b != NULL; b = next) {
+		next = b->b_lrunext;
+		if (b->b_dev != dev) {
+			continue;
+		}
+		if (b->b_busy) {
+			cv_wait(buf_cv, buf_lock);
+			goto again;
+		}
+		if (b->b_dirty) {
+			result = buf_writeback(b);
+			if (result) {
+				lock_release(buf_lock);
+				return result;
+			}
+			goto again;
+		}
+		buf_forget(b);
+
+		/* Empty buffers go to the end, to be reused first */
+		buf_lruremove(b);
+		buf_lruinsert_tail(b);
+	}
+	lock_release(buf_lock);
+
+	return 0;
+}
+
+void
+buf_printstats(void)
+{
+	u_int32_t lookups;
+
+	lock_acquire(buf_lock);
+	lookups = buf_hits + buf_misses;
+	kprintf("buf: %d of %d buffers in use\n", buf_count, BUF_NBUFS);
+	kprintf("buf: %u lookups, %u hits (%u%%), %u misses, %u evictions\n",
+		lookups, buf_hits,
+		lookups > 0 ? buf_hits * 100 / lookups : 0,
+		buf_misses, buf_evictions);
+	kprintf("buf: %u disk reads, %u disk writes in %u requests\n",
+		buf_diskreads, buf_diskwrites, buf_writereqs);
+	kprintf("buf: %u dirty, syncer flushed %u times\n",
+		buf_ndirty, buf_syncerruns);
+	kprintf("buf: %u direct requests for %u blocks\n",
+		buf_directreqs, buf_directblocks);
+	kprintf("buf: %u read-ahead requests (%u dropped), %u blocks read "
+		"ahead\n", buf_rareqs, buf_radropped, buf_rablocks);
+	lock_release(buf_lock);
+}
@@ -0,0 +1,302 @@
+/*
+ * Directory name lookup cache. See dcache.h.
+ *
+ * A fixed pool of entries, found through a hash table on (directory,
+ * name) and kept on an LRU list, most recently used at the head. When
+ * the pool is full the entry at the tail is reused.
+ *
+ * Dropping an entry drops its vnode references, which may reclaim a
+ * vnode. That's done with dcache_lock held; no filesystem calls back
+ * into the name cache from reclaim, so this can't deadlock.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <synch.h>
+#include <vnode.h>
+#include <dcache.h>
+
+#define DCACHE_HASHSIZE  67
+
+struct dcentry {
+	struct vnode *dc_dir;		/* directory; NULL if entry unused */
+	struct vnode *dc_vn;		/* what the name refers to, or NULL */
+	char dc_name[DCACHE_NAMELEN];
+
+	struct dcentry *dc_hashnext;
+	struct dcentry *dc_lruprev;
+	struct dcentry *dc_lrunext;
+};
+
+static struct lock *dcache_lock;
+static struct dcentry dcache_entries[DCACHE_SIZE];
+static struct dcentry *dcache_hash[DCACHE_HASHSIZE];
+static struct dcentry *dcache_lruhead;
+static struct dcentry *dcache_lrutail;
+
+/* Statistics */
+static u_int32_t dcache_hits;		/* positive entry found */
+static u_int32_t dcache_neghits;	/* negative entry found */
+static u_int32_t dcache_misses;		/* nothing found */
+static u_int32_t dcache_enters;		/* entries made */
+static u_int32_t dcache_removes;	/* entries invalidated */
+
+////////////////////////////////////////////////////////////
+//
+// Internals. Must hold dcache_lock.
+
+static
+unsigned
+dcache_hashfn(struct vnode *dir, const char *name)
+{
+	u_int32_t h = (u_int32_t)dir >> 4;
+
+	while (*name) {
+		h = h*33 + (unsigned char)*name++;
+	}
+	return h % DCACHE_HASHSIZE;
+}
+
+static
+void
+dcache_lruremove(struct dcentry *e)
+{
+	if (e->dc_lruprev != NULL) {
+		e->dc_lruprev->dc_lrunext = e->dc_lrunext;
+	}
+	else {
+		dcache_lruhead = e->dc_lrunext;
+	}
+	if (e->dc_lrunext != NULL) {
+		e->dc_lrunext->dc_lruprev = e->dc_lruprev;
+	}
+	else {
+		dcache_lrutail = e->dc_lruprev;
+	}
+	e->dc_lruprev = e->dc_lrunext = NULL;
+}
+
+static
+void
+dcache_lruinsert_head(struct dcentry *e)
+{
+	e->dc_lruprev = NULL;
+	e->dc_lrunext = dcache_lruhead;
+	if (dcache_lruhead != NULL) {
+		dcache_lruhead->dc_lruprev = e;
+	}
+	else {
+		dcache_lrutail = e;
+	}
+	dcache_lruhead = e;
+}
+
+static
+void
+dcache_lruinsert_tail(struct dcentry *e)
+{
+	e->dc_lrunext = NULL;
+	e->dc_lruprev = dcache_lrutail;
+	if (dcache_lrutail != NULL) {
+		dcache_lrutail->dc_lrunext = e;
+	}
+	else {
+		dcache_lruhead = e;
+	}
+	dcache_lrutail = e;
+}
+
+static
+struct dcentry *
+dcache_find(struct vnode *dir, const char *name)
+{
+	struct dcentry *e;
+
+	e = dcache_hash[dcache_hashfn(dir, name)];
+	for (; e != NULL; e = e->dc_hashnext) {
+		if (e->dc_dir == dir && !strcmp(e->dc_name, name)) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Empty out an entry and move it to the tail of the LRU list, where it
+ * will be reused first.
+ */
+static
+void
+dcache_drop(struct dcentry *e)
+{
+	struct dcentry **ep;
+
+	assert(e->dc_dir != NULL);
+
+	ep = &dcache_hash[dcache_hashfn(e->dc_dir, e->dc_name)];
+	while (*ep != e) {
+		assert(*ep != NULL);
+		ep = &(*ep)->dc_hashnext;
+	}
+	*ep = e->dc_hashnext;
+	e->dc_hashnext = NULL;
+
+	if (e->dc_vn != NULL) {
+		VOP_DECREF(e->dc_vn);
+		e->dc_vn = NULL;
+	}
+	VOP_DECREF(e->dc_dir);
+	e->dc_dir = NULL;
+
+	dcache_lruremove(e);
+	dcache_lruinsert_tail(e);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Interface
+
+void
+dcache_bootstrap(void)
+{
+	int i;
+
+	dcache_lock = lock_create("dcache");
+	if (dcache_lock == NULL) {
+		panic("dcache: Could not create lock\n");
+	}
+
+	for (i=0; i<DCACHE_SIZE; i++) {
+		dcache_entries[i].dc_dir = NULL;
+		dcache_entries[i].dc_vn = NULL;
+		dcache_entries[i].dc_hashnext = NULL;
+		dcache_lruinsert_tail(&dcache_entries[i]);
+	}
+}
+
+int
+dcache_lookup(struct vnode *dir, const char *name, struct vnode **ret)
+{
+	struct dcentry *e;
+
+	if (strlen(name) >= DCACHE_NAMELEN) {
+		return 0;
+	}
+
+	lock_acquire(dcache_lock);
+
+	e = dcache_find(dir, name);
+	if (e == NULL) {
+		dcache_misses++;
+		lock_release(dcache_lock);
+		return 0;
+	}
+
+	if (e->dc_vn != NULL) {
+		VOP_INCREF(e->dc_vn);
+		dcache_hits++;
+	}
+	else {
+		dcache_neghits++;
+	}
+	*ret = e->dc_vn;
+
+	dcache_lruremove(e);
+	dcache_lruinsert_head(e);
+
+	lock_release(dcache_lock);
+	return 1;
+}
+
+void
+dcache_enter(struct vnode *dir, const char *name, struct vnode *vn)
+{
+	struct dcentry *e;
+	unsigned h;
+
+	if (strlen(name) >= DCACHE_NAMELEN) {
+		return;
+	}
+
+	lock_acquire(dcache_lock);
+
+	/* Replace any existing entry for the name */
+	e = dcache_find(dir, name);
+	if (e != NULL) {
+		dcache_drop(e);
+	}
+
+	/* Take the least recently used entry */
+	e = dcache_lrutail;
+	if (e->dc_dir != NULL) {
+		dcache_drop(e);
+	}
+
+	VOP_INCREF(dir);
+	e->dc_dir = dir;
+	if (vn != NULL) {
+		VOP_INCREF(vn);
+	}
+	e->dc_vn = vn;
+	strcpy(e->dc_name, name);
+
+	h = dcache_hashfn(dir, name);
+	e->dc_hashnext = dcache_hash[h];
+	dcache_hash[h] = e;
+
+	dcache_lruremove(e);
+	dcache_lruinsert_head(e);
+	dcache_enters++;
+
+	lock_release(dcache_lock);
+}
+
+void
+dcache_remove(struct vnode *dir, const char *name)
+{
+	struct dcentry *e;
+
+	if (strlen(name) >= DCACHE_NAMELEN) {
+		return;
+	}
+
+	lock_acquire(dcache_lock);
+	e = dcache_find(dir, name);
+	if (e != NULL) {
+		dcache_drop(e);
+		dcache_removes++;
+	}
+	lock_release(dcache_lock);
+}
+
+void
+dcache_purgefs(struct fs *fs)
+{
+	int i;
+
+	lock_acquire(dcache_lock);
+	for (i=0; i<DCACHE_SIZE; i++) {
+		struct dcentry *e = &dcache_entries[i];
+		if (e->dc_dir != NULL && e->dc_dir->vn_fs == fs) {
+			dcache_drop(e);
+		}
+	}
+	lock_release(dcache_lock);
+}
+
+void
+dcache_printstats(void)
+{
+	u_int32_t lookups;
+
+	lock_acquire(dcache_lock);
+	lookups = dcache_hits + dcache_neghits + dcache_misses;
+	kprintf("dcache: %u lookups, %u hits, %u negative hits, "
+		"%u misses (%u%% hit)\n",
+		lookups, dcache_hits, dcache_neghits, dcache_misses,
+		lookups > 0 ? (dcache_hits + dcache_neghits) * 100 / lookups
+		: 0);
+	kprintf("dcache: %u entries made, %u invalidated\n",
+		dcache_enters, dcache_removes);
+	lock_release(dcache_lock);
+}
@@ -156,6 +156,23 @@ dev_gettype(struct vnode *v, u_int32_t *ret)
 	return 0;
 }
 
+/*
+ * Check for readiness. Devices that can't make you wait (disks, null,
+ * random) don't have a poll function and are always ready.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, int *revents)
+{
+	struct device *d = v->vn_data;
+	if (d->d_poll == NULL) {
+		*revents = events;
+		return 0;
+	}
+	*revents = d->d_poll(d, events);
+	return 0;
+}
+
 /*
  * Attempt a seek.
  * For block devices, require block alignment.
@@ -371,10 +388,12 @@ static const struct vnode_ops dev_vnode_ops = {
 	dev_read,
 	null_io,      /* readlink */
 	null_io,      /* getdirentry */
+	null_io,      /* getdirentries */
 	dev_write,
 	dev_ioctl,
 	dev_stat,
 	dev_gettype,
+	dev_poll,
 	dev_tryseek,
 	null_fsync,
 	dev_mmap,
@@ -0,0 +1,621 @@
+/*
+ * Pipe vnodes. See pipe.h.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/limits.h>
+#include <kern/stat.h>
+#include <lib.h>
+#include <synch.h>
+#include <uio.h>
+#include <vm.h>
+#include <thread.h>
+#include <curthread.h>
+#include <vnode.h>
+#include <pipe.h>
+#include <poll.h>
+#include <kern/poll.h>
+
+#define PIPE_SIZE    (PIPE_PAGES * PAGE_SIZE)
+
+/* Writes at least this big lend their buffer instead of copying. */
+#define PIPE_LOANMIN PAGE_SIZE
+
+struct pipe {
+	struct lock *p_lock;		/* protects everything here */
+	struct cv *p_readcv;		/* readers wait here for data */
+	struct cv *p_writecv;		/* writers wait here for room */
+
+	char *p_buf;			/* ring buffer */
+	size_t p_head;			/* where the next read comes from */
+	size_t p_count;			/* bytes in the ring */
+
+	int p_rdopen;			/* read end still open */
+	int p_wropen;			/* write end still open */
+	int p_ends;			/* end vnodes not yet reclaimed */
+
+	/* Writer's buffer on loan to readers, if any */
+	struct addrspace *p_loanas;	/* writer's address space */
+	vaddr_t p_loanaddr;		/* next byte to read */
+	size_t p_loanlen;		/* bytes left */
+	int p_loanerr;			/* set if the buffer was bad */
+
+	struct vnode p_rvn;		/* read end */
+	struct vnode p_wvn;		/* write end */
+};
+
+static
+void
+pipe_destroy(struct pipe *p)
+{
+	if (p->p_writecv != NULL) {
+		cv_destroy(p->p_writecv);
+	}
+	if (p->p_readcv != NULL) {
+		cv_destroy(p->p_readcv);
+	}
+	if (p->p_lock != NULL) {
+		lock_destroy(p->p_lock);
+	}
+	if (p->p_buf != NULL) {
+		kfree(p->p_buf);
+	}
+	kfree(p);
+}
+
+static
+int
+pipe_open(struct vnode *v, int openflags)
+{
+	(void)v;
+	(void)openflags;
+	return 0;
+}
+
+/*
+ * Called on last close of one end. Wake up anyone waiting on the other
+ * end so they see EOF or EPIPE.
+ */
+static
+int
+pipe_close(struct vnode *v)
+{
+	struct pipe *p = v->vn_data;
+
+	lock_acquire(p->p_lock);
+	if (v == &p->p_rvn) {
+		p->p_rdopen = 0;
+	}
+	else {
+		p->p_wropen = 0;
+	}
+	cv_broadcast(p->p_readcv, p->p_lock);
+	cv_broadcast(p->p_writecv, p->p_lock);
+	lock_release(p->p_lock);
+	poll_wakeup();
+
+	return 0;
+}
+
+/*
+ * Called when one end is no longer referenced. The pipe goes away
+ * along with the second end.
+ */
+static
+int
+pipe_reclaim(struct vnode *v)
+{
+	struct pipe *p = v->vn_data;
+	int last;
+
+	VOP_KILL(v);
+
+	lock_acquire(p->p_lock);
+	assert(p->p_ends > 0);
+	p->p_ends--;
+	last = (p->p_ends == 0);
+	lock_release(p->p_lock);
+
+	if (last) {
+		pipe_destroy(p);
+	}
+	return 0;
+}
+
+/*
+ * Copy up to the rest of the uio out of the writer's lent buffer, a
+ * page at a time. Must hold p_lock.
+ */
+static
+int
+pipe_readloan(struct pipe *p, struct uio *uio)
+{
+	paddr_t pa;
+	size_t n;
+	int result;
+
+	while (p->p_loanlen > 0 && uio->uio_resid > 0) {
+		/* Don't run off the end of the page */
+		n = PAGE_SIZE - (p->p_loanaddr & ~PAGE_FRAME);
+		if (n > p->p_loanlen) {
+			n = p->p_loanlen;
+		}
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+
+		if (vm_translate(p->p_loanas, p->p_loanaddr, &pa)) {
+			/* Writer passed a bad pointer; it gets the error */
+			p->p_loanerr = EFAULT;
+			p->p_loanlen = 0;
+			break;
+		}
+
+		result = uiomove((void *)PADDR_TO_KVADDR(pa), n, uio);
+		if (result) {
+			return result;
+		}
+		p->p_loanaddr += n;
+		p->p_loanlen -= n;
+	}
+	return 0;
+}
+
+/*
+ * Read whatever is available, waiting only if there's nothing at all.
+ */
+static
+int
+pipe_read(struct vnode *v, struct uio *uio)
+{
+	struct pipe *p = v->vn_data;
+	size_t n;
+	int result = 0;
+
+	if (v != &p->p_rvn) {
+		return EBADF;
+	}
+
+	lock_acquire(p->p_lock);
+
+	while (p->p_count == 0 && p->p_loanlen == 0) {
+		if (!p->p_wropen) {
+			/* EOF */
+			lock_release(p->p_lock);
+			return 0;
+		}
+		cv_wait(p->p_readcv, p->p_lock);
+	}
+
+	/* Anything in the ring was written before any loan was made. */
+	while (p->p_count > 0 && uio->uio_resid > 0) {
+		n = p->p_count;
+		if (n > PIPE_SIZE - p->p_head) {
+			n = PIPE_SIZE - p->p_head;
+		}
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove(p->p_buf + p->p_head, n, uio);
+		if (result) {
+			break;
+		}
+		p->p_head = (p->p_head + n) % PIPE_SIZE;
+		p->p_count -= n;
+	}
+
+	if (result == 0) {
+		result = pipe_readloan(p, uio);
+	}
+
+	cv_broadcast(p->p_writecv, p->p_lock);
+	lock_release(p->p_lock);
+	poll_wakeup();
+	return result;
+}
+
+/*
+ * Lend the writer's current buffer to readers and wait for them to
+ * empty it. Must hold p_lock; the ring must be empty.
+ */
+static
+int
+pipe_writeloan(struct pipe *p, struct uio *uio)
+{
+	struct iovec *iov;
+	size_t done;
+	int result;
+
+	/* Skip any empty buffers */
+	while (uio->uio_iov->iov_len == 0) {
+		assert(uio->uio_iovcnt > 1);
+		uio->uio_iov++;
+		uio->uio_iovcnt--;
+	}
+	iov = uio->uio_iov;
+
+	p->p_loanas = curthread->t_vmspace;
+	p->p_loanaddr = (vaddr_t)iov->iov_ubase;
+	p->p_loanlen = iov->iov_len;
+	if (p->p_loanlen > uio->uio_resid) {
+		p->p_loanlen = uio->uio_resid;
+	}
+	p->p_loanerr = 0;
+	done = p->p_loanlen;
+
+	cv_broadcast(p->p_readcv, p->p_lock);
+	poll_wakeup();
+	while (p->p_loanlen > 0 && p->p_rdopen) {
+		cv_wait(p->p_writecv, p->p_lock);
+	}
+
+	/* Account for what the readers took */
+	done -= p->p_loanlen;
+	iov->iov_ubase += done;
+	iov->iov_len -= done;
+	uio->uio_resid -= done;
+	uio->uio_offset += done;
+
+	result = p->p_loanerr;
+	p->p_loanas = NULL;
+	p->p_loanlen = 0;
+
+	/* Let other writers in */
+	cv_broadcast(p->p_writecv, p->p_lock);
+	poll_wakeup();
+	return result;
+}
+
+static
+int
+pipe_write(struct vnode *v, struct uio *uio)
+{
+	struct pipe *p = v->vn_data;
+	size_t total, space, tail, n;
+	int result = 0;
+
+	if (v != &p->p_wvn) {
+		return EBADF;
+	}
+
+	total = uio->uio_resid;
+
+	lock_acquire(p->p_lock);
+
+	while (uio->uio_resid > 0) {
+		if (!p->p_rdopen) {
+			/* Report a short write if we got anything across */
+			if (uio->uio_resid == total) {
+				result = EPIPE;
+			}
+			break;
+		}
+
+		/* Wait for any other writer's loan to finish */
+		if (p->p_loanas != NULL) {
+			cv_wait(p->p_writecv, p->p_lock);
+			continue;
+		}
+
+		/* Small writes have to go in all at once */
+		space = PIPE_SIZE - p->p_count;
+		if (total <= PIPE_BUF && space < uio->uio_resid) {
+			cv_wait(p->p_writecv, p->p_lock);
+			continue;
+		}
+
+		/* Big writes from user space lend their pages instead */
+		if (uio->uio_resid >= PIPE_LOANMIN && p->p_count == 0 &&
+		    uio->uio_segflg == UIO_USERSPACE) {
+			result = pipe_writeloan(p, uio);
+			if (result) {
+				break;
+			}
+			continue;
+		}
+
+		if (space == 0) {
+			cv_wait(p->p_writecv, p->p_lock);
+			continue;
+		}
+
+		tail = (p->p_head + p->p_count) % PIPE_SIZE;
+		n = space;
+		if (n > PIPE_SIZE - tail) {
+			n = PIPE_SIZE - tail;
+		}
+		if (n > uio->uio_resid) {
+			n = uio->uio_resid;
+		}
+		result = uiomove(p->p_buf + tail, n, uio);
+		if (result) {
+			break;
+		}
+		p->p_count += n;
+		cv_broadcast(p->p_readcv, p->p_lock);
+		poll_wakeup();
+	}
+
+	lock_release(p->p_lock);
+	return result;
+}
+
+static
+int
+pipe_stat(struct vnode *v, struct stat *statbuf)
+{
+	struct pipe *p = v->vn_data;
+
+	bzero(statbuf, sizeof(struct stat));
+	statbuf->st_mode = S_IFIFO;
+	statbuf->st_nlink = 1;
+
+	lock_acquire(p->p_lock);
+	statbuf->st_size = p->p_count + p->p_loanlen;
+	lock_release(p->p_lock);
+
+	return 0;
+}
+
+static
+int
+pipe_gettype(struct vnode *v, u_int32_t *ret)
+{
+	(void)v;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+/*
+ * The read end is ready if there is data or the writer is gone; the
+ * write end if there is room (for a PIPE_BUF write) or the reader is
+ * gone, in which case writing fails at once.
+ */
+static
+int
+pipe_poll(struct vnode *v, int events, int *revents)
+{
+	struct pipe *p = v->vn_data;
+	int rev = 0;
+
+	lock_acquire(p->p_lock);
+	if (v == &p->p_rvn) {
+		if (p->p_count > 0 || p->p_loanlen > 0) {
+			rev |= events & POLLIN;
+		}
+		if (!p->p_wropen) {
+			rev |= POLLHUP;
+		}
+	}
+	else {
+		if (!p->p_rdopen) {
+			rev |= POLLERR;
+		}
+		else if (p->p_loanas == NULL &&
+			 PIPE_SIZE - p->p_count >= PIPE_BUF) {
+			rev |= events & POLLOUT;
+		}
+	}
+	lock_release(p->p_lock);
+
+	*revents = rev;
+	return 0;
+}
+
+static
+int
+pipe_tryseek(struct vnode *v, off_t pos)
+{
+	(void)v;
+	(void)pos;
+	return ESPIPE;
+}
+
+static
+int
+pipe_fsync(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+/*
+ * Used for several functions with the same type signature that are
+ * not meaningful on pipes.
+ */
+static
+int
+pipe_badio(struct vnode *v, struct uio *uio)
+{
+	(void)v;
+	(void)uio;
+	return EINVAL;
+}
+
+static
+int
+pipe_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	(void)v;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+static
+int
+pipe_mmap(struct vnode *v)
+{
+	(void)v;
+	return EUNIMP;
+}
+
+static
+int
+pipe_truncate(struct vnode *v, off_t len)
+{
+	(void)v;
+	(void)len;
+	return EINVAL;
+}
+
+static
+int
+pipe_creat(struct vnode *v, const char *name, int excl, struct vnode **result)
+{
+	(void)v;
+	(void)name;
+	(void)excl;
+	(void)result;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_symlink(struct vnode *v, const char *contents, const char *name)
+{
+	(void)v;
+	(void)contents;
+	(void)name;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_nameop(struct vnode *v, const char *name)
+{
+	(void)v;
+	(void)name;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_link(struct vnode *v, const char *name, struct vnode *file)
+{
+	(void)v;
+	(void)name;
+	(void)file;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_rename(struct vnode *v, const char *n1, struct vnode *v2, const char *n2)
+{
+	(void)v;
+	(void)n1;
+	(void)v2;
+	(void)n2;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_lookup(struct vnode *v, char *path, struct vnode **result)
+{
+	(void)v;
+	(void)path;
+	(void)result;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_lookparent(struct vnode *v, char *path, struct vnode **result,
+		char *buf, size_t len)
+{
+	(void)v;
+	(void)path;
+	(void)result;
+	(void)buf;
+	(void)len;
+	return ENOTDIR;
+}
+
+static const struct vnode_ops pipe_vnode_ops = {
+	VOP_MAGIC,
+
+	pipe_open,
+	pipe_close,
+	pipe_reclaim,
+	pipe_read,
+	pipe_badio,   /* readlink */
+	pipe_badio,   /* getdirentry */
+	pipe_badio,   /* getdirentries */
+	pipe_write,
+	pipe_ioctl,
+	pipe_stat,
+	pipe_gettype,
+	pipe_poll,
+	pipe_tryseek,
+	pipe_fsync,
+	pipe_mmap,
+	pipe_truncate,
+	pipe_badio,   /* namefile */
+	pipe_creat,
+	pipe_symlink,
+	pipe_nameop,  /* mkdir */
+	pipe_link,
+	pipe_nameop,  /* remove */
+	pipe_nameop,  /* rmdir */
+	pipe_rename,
+	pipe_lookup,
+	pipe_lookparent,
+};
+
+int
+pipe_create(struct vnode **readvn, struct vnode **writevn)
+{
+	struct pipe *p;
+	int result;
+
+	p = kmalloc(sizeof(struct pipe));
+	if (p == NULL) {
+		return ENOMEM;
+	}
+	p->p_buf = NULL;
+	p->p_lock = NULL;
+	p->p_readcv = NULL;
+	p->p_writecv = NULL;
+
+	p->p_buf = kmalloc(PIPE_SIZE);
+	p->p_lock = lock_create("pipe");
+	p->p_readcv = cv_create("pipe-read");
+	p->p_writecv = cv_create("pipe-write");
+	if (p->p_buf == NULL || p->p_lock == NULL ||
+	    p->p_readcv == NULL || p->p_writecv == NULL) {
+		pipe_destroy(p);
+		return ENOMEM;
+	}
+
+	p->p_head = 0;
+	p->p_count = 0;
+	p->p_rdopen = 1;
+	p->p_wropen = 1;
+	p->p_ends = 2;
+	p->p_loanas = NULL;
+	p->p_loanaddr = 0;
+	p->p_loanlen = 0;
+	p->p_loanerr = 0;
+
+	result = VOP_INIT(&p->p_rvn, &pipe_vnode_ops, NULL, p);
+	if (result) {
+		pipe_destroy(p);
+		return result;
+	}
+	result = VOP_INIT(&p->p_wvn, &pipe_vnode_ops, NULL, p);
+	if (result) {
+		VOP_KILL(&p->p_rvn);
+		pipe_destroy(p);
+		return result;
+	}
+
+	/* Each end starts out open once, as vfs_open would leave it */
+	VOP_INCOPEN(&p->p_rvn);
+	VOP_INCOPEN(&p->p_wvn);
+
+	*readvn = &p->p_rvn;
+	*writevn = &p->p_wvn;
+	return 0;
+}
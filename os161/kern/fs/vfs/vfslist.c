@@ -12,6 +12,8 @@
 #include <vnode.h>
 #include <fs.h>
 #include <dev.h>
+#include <buf.h>
+#include <dcache.h>
 
 /*
  * Structure for a single named device.
@@ -69,6 +71,8 @@ vfs_bootstrap(void)
 		panic("vfs: Could not create knowndevs lock\n");
 	}
 
+	buf_bootstrap();
+	dcache_bootstrap();
 	vfs_initbootfs();
 	devnull_create();
 }
@@ -505,6 +509,9 @@ vfs_unmount(const char *devname)
 	assert(kd->kd_rawname != NULL);
 	assert(kd->kd_device != NULL);
 
+	/* Cached names hold vnodes, which would keep the fs busy */
+	dcache_purgefs(kd->kd_fs);
+
 	result = FSOP_SYNC(kd->kd_fs);
 	if (result) {
 		goto puke;
@@ -552,6 +559,8 @@ vfs_unmountall(void)
 
 		kprintf("vfs: Unmounting %s:\n", dev->kd_name);
 
+		dcache_purgefs(dev->kd_fs);
+
 		result = FSOP_SYNC(dev->kd_fs);
 		if (result) {
 			kprintf("vfs: Warning: sync failed for %s: %s, trying "
@@ -0,0 +1,104 @@
+#ifndef _BUF_H_
+#define _BUF_H_
+
+/*
+ * Block buffer cache.
+ *
+ * Caches disk blocks in memory, keyed by (device, block number). All
+ * of a filesystem's block I/O goes through here, so metadata that is
+ * read over and over (inodes, indirect blocks, directories) stays in
+ * memory, and partial-block writes don't have to reread the block.
+ *
+ * A buffer returned by buf_read or buf_get is held by the caller: no
+ * other thread can get at it, and it won't be evicted, until it is
+ * handed back with buf_release. Hold buffers only briefly, and never
+ * try to get a buffer you already hold.
+ *
+ * Writes are delayed. A buffer marked dirty is written out when it has
+ * been dirty for a few seconds, when too many buffers are dirty, when
+ * it is evicted to make room (least recently used first), or by
+ * buf_sync or buf_syncrange; each time together with any dirty
+ * neighbours on disk.
+ *
+ * Functions:
+ *     buf_bootstrap  - set up the cache. Called once at boot.
+ *     buf_read       - get the buffer for BLOCK on DEV, reading it from
+ *                      disk if it isn't cached.
+ *     buf_get        - get the buffer for BLOCK on DEV without reading
+ *                      it; for callers about to overwrite all of it.
+ *                      The contents are undefined if it wasn't cached.
+ *     buf_markdirty  - note that a held buffer has been changed.
+ *     buf_release    - give back a held buffer.
+ *     buf_invalidate - give back a held buffer whose contents were
+ *                      damaged by an update that failed partway. If
+ *                      it wasn't dirty, the cached copy is dropped,
+ *                      so the block is read from disk again.
+ *     buf_directio   - read NBLOCKS blocks starting at BLOCK on DEV
+ *                      into UIO in a single device request, without
+ *                      going through buffers. Dirty cached copies are
+ *                      written out first. UIO's offset is advanced as
+ *                      if it were a file offset. For big sequential
+ *                      reads; reads only (writes go through the cache).
+ *     buf_readahead  - start reading NBLOCKS blocks starting at BLOCK
+ *                      on DEV into the cache, and return without
+ *                      waiting. Only a hint; may be ignored.
+ *     buf_sync       - write out all dirty buffers for DEV, waiting
+ *                      for any that are held.
+ *     buf_syncrange  - write out dirty buffers for NBLOCKS blocks
+ *                      starting at BLOCK on DEV (for fsync).
+ *     buf_purge      - write out and then drop all buffers for DEV
+ *                      (for unmount). The filesystem must hold none;
+ *                      ones the cache is busy with are waited for.
+ *     buf_printstats - print hit and I/O counts.
+ */
+
+/* All cached devices use this block size. */
+#define BUF_BLOCKSIZE  512
+
+/* Number of buffers in the cache. */
+#define BUF_NBUFS      256
+
+/* Most blocks read ahead in one device request. */
+#define BUF_RAMAX      32
+
+/* Most dirty blocks written back in one device request. */
+#define BUF_CLUSTER    16
+
+struct device;
+struct uio;
+
+struct buf {
+	struct device *b_dev;		/* device the block is on */
+	u_int32_t b_block;		/* block number on the device */
+	void *b_data;			/* BUF_BLOCKSIZE bytes */
+
+	int b_valid;			/* b_data holds the block contents */
+	int b_dirty;			/* b_data is newer than the disk */
+	int b_busy;			/* held by somebody */
+	time_t b_dirtytime;		/* when it became dirty */
+
+	struct buf *b_hashnext;		/* hash chain */
+	struct buf *b_lruprev;		/* LRU list, most recent at head */
+	struct buf *b_lrunext;
+};
+
+void buf_bootstrap(void);
+
+int buf_read(struct device *dev, u_int32_t block, struct buf **ret);
+int buf_get(struct device *dev, u_int32_t block, struct buf **ret);
+void buf_markdirty(struct buf *b);
+void buf_release(struct buf *b);
+void buf_invalidate(struct buf *b);
+
+int buf_directio(struct device *dev, u_int32_t block, u_int32_t nblocks,
+		 struct uio *uio);
+
+void buf_readahead(struct device *dev, u_int32_t block, u_int32_t nblocks);
+
+int buf_sync(struct device *dev);
+int buf_syncrange(struct device *dev, u_int32_t block, u_int32_t nblocks);
+int buf_purge(struct device *dev);
+
+void buf_printstats(void);
+
+#endif /* _BUF_H_ */
@@ -0,0 +1,57 @@
+#ifndef _CALLOUT_H_
+#define _CALLOUT_H_
+
+/*
+ * One-shot timed callouts, kept in a hierarchical timer wheel that is
+ * advanced by hardclock() once per tick.
+ *
+ * The callout structure is owned by the caller (it may be embedded in
+ * another structure or live on the stack) and must not be freed while
+ * it is pending.
+ *
+ * Functions:
+ *     callout_init   - initialize a callout. Must be done before any
+ *                      other operation.
+ *     callout_reset  - arrange for FUNC(ARG) to be called TICKS clock
+ *                      ticks (1/HZ seconds) from now. If the callout
+ *                      was already pending it is rescheduled. TICKS
+ *                      less than 1 is treated as 1, and more than
+ *                      CALLOUT_MAXTICKS as CALLOUT_MAXTICKS.
+ *     callout_stop   - cancel a pending callout. Returns nonzero if it
+ *                      was pending (and so will not now run).
+ *     callout_pending - return nonzero if the callout has not yet run.
+ *
+ * The callout function is called from hardclock() in interrupt
+ * context, with interrupts off. It may wake threads up, but must not
+ * sleep.
+ *
+ * The following are for the clock code:
+ *     callout_tick      - process one clock tick. O(1) amortized.
+ *     callout_nextevent - return the number of ticks until the next
+ *                         callout might be due, at most MAXTICKS.
+ *     callout_getticks  - number of ticks processed since boot.
+ */
+
+/* Longest delay the wheel can represent (about 46 hours at 100 HZ) */
+#define CALLOUT_MAXTICKS  ((1 << 24) - 1)
+
+struct callout {
+	struct callout *c_next;		/* next on wheel slot list */
+	struct callout **c_prevnext;	/* pointer to our list link */
+	u_int32_t c_expire;		/* tick at which to run */
+	void (*c_func)(void *);		/* function to call */
+	void *c_arg;			/* argument for c_func */
+	int c_pending;			/* nonzero if on the wheel */
+};
+
+void callout_init(struct callout *c);
+void callout_reset(struct callout *c, u_int32_t ticks,
+		   void (*func)(void *), void *arg);
+int callout_stop(struct callout *c);
+int callout_pending(struct callout *c);
+
+void callout_tick(void);
+u_int32_t callout_nextevent(u_int32_t maxticks);
+u_int32_t callout_getticks(void);
+
+#endif /* _CALLOUT_H_ */
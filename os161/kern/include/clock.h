@@ -7,6 +7,8 @@
  * Time-related definitions.
  *
  * hardclock() is called from the timer interrupt HZ times a second.
+ * It only forces a context switch once the current thread has run for
+ * QUANTUM ticks and something else is runnable.
  * gettime() may be used to fetch the current time of day.
  * getinterval() computes the time from time1 to time2.
  */
@@ -20,8 +22,41 @@
 #define HZ  100
 #endif
 
+/* hardclocks a thread may run before being preempted */
+#if OPT_SYNCHPROBS
+#define QUANTUM  1
+#else
+#define QUANTUM  2
+#endif
+
 void hardclock(void);
 
+/*
+ * Tickless idle support.
+ *
+ * hardclock_register is called by the timer driver doing hardclock if
+ * its interrupt interval can be changed. While the scheduler has
+ * nothing to run, it calls hardclock_idle_enter, which stretches the
+ * timer out to the next pending event; hardclock_idle_exit accounts
+ * for the skipped ticks and goes back to ticking HZ times a second.
+ *
+ * hardclock_printstats prints tick and context switch counts.
+ */
+void hardclock_register(void *devdata,
+			void (*settimer)(void *devdata, u_int32_t usecs),
+			void (*gettime)(void *devdata,
+					time_t *secs, u_int32_t *nsecs));
+void hardclock_idle_enter(void);
+void hardclock_idle_exit(void);
+void hardclock_printstats(void);
+
+/*
+ * The clock page (see kern/clockpage.h). hardclock keeps it up to date;
+ * vm_fault maps it into user address spaces.
+ */
+void clockpage_bootstrap(void);
+paddr_t clockpage_paddr(void);
+
 void gettime(time_t *seconds, u_int32_t *nanoseconds);
 
 void getinterval(time_t secs1, u_int32_t nsecs,
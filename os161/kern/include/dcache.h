@@ -0,0 +1,45 @@
+#ifndef _DCACHE_H_
+#define _DCACHE_H_
+
+/*
+ * Directory name lookup cache.
+ *
+ * Remembers the results of looking up single names in directories:
+ * (directory vnode, name) -> vnode, or -> "no such file" for negative
+ * entries. Filesystems call into it from their lookup routines and
+ * must invalidate names whenever they change a directory.
+ *
+ * Each entry holds a reference to its directory and (if positive) to
+ * the vnode it names, so cached vnodes stay loaded. Names longer than
+ * DCACHE_NAMELEN-1 characters are never cached.
+ *
+ * Functions:
+ *     dcache_bootstrap  - set up the cache. Called once at boot.
+ *     dcache_lookup     - look up NAME in DIR. Returns 0 on a miss.
+ *                         Otherwise returns nonzero and sets *RET to a
+ *                         new reference to the vnode, or to NULL if
+ *                         the name is known not to exist.
+ *     dcache_enter      - remember that NAME in DIR is VN (NULL for a
+ *                         name that doesn't exist).
+ *     dcache_remove     - forget NAME in DIR. Call before changing
+ *                         what NAME refers to.
+ *     dcache_purgefs    - forget everything on FS (for unmount).
+ *     dcache_printstats - print hit and miss counts.
+ */
+
+#define DCACHE_NAMELEN  32
+#define DCACHE_SIZE     128
+
+struct vnode;
+struct fs;
+
+void dcache_bootstrap(void);
+
+int dcache_lookup(struct vnode *dir, const char *name, struct vnode **ret);
+void dcache_enter(struct vnode *dir, const char *name, struct vnode *vn);
+void dcache_remove(struct vnode *dir, const char *name);
+void dcache_purgefs(struct fs *fs);
+
+void dcache_printstats(void);
+
+#endif /* _DCACHE_H_ */
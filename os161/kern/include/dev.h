@@ -6,12 +6,15 @@ struct uio;  /* in <uio.h> */
 /*
  * Filesystem-namespace-accessible device.
  * d_io is for both reads and writes; the uio indicates which should be done.
+ * d_poll returns which of the POLL* events asked for (see kern/poll.h)
+ * the device is ready for; it may be NULL if I/O never has to wait.
  */
 struct device {
 	int (*d_open)(struct device *, int flags_from_open);
 	int (*d_close)(struct device *);
 	int (*d_io)(struct device *, struct uio *);
 	int (*d_ioctl)(struct device *, int op, userptr_t data);
+	int (*d_poll)(struct device *, int events);
 
 	u_int32_t d_blocks;
 	u_int32_t d_blocksize;
@@ -0,0 +1,72 @@
+#ifndef _FILE_H_
+#define _FILE_H_
+
+/*
+ * Open files and per-process file descriptor tables.
+ *
+ * An openfile is what open() creates: a vnode plus the state that goes
+ * with one particular open of it (offset and open flags). File
+ * descriptors refer to openfiles; after fork() or dup2() several
+ * descriptors, possibly in different processes, share the same
+ * openfile and therefore the same offset.
+ *
+ * of_lock protects of_offset. It is held across a read or write so
+ * that concurrent users of a shared openfile see consistent offsets.
+ * of_refcount is updated with interrupts off, so closing a descriptor
+ * never waits for somebody else's I/O to finish.
+ */
+
+#include <kern/limits.h>
+
+struct vnode;
+struct lock;
+
+struct openfile {
+	struct vnode *of_vnode;		/* the open object */
+	off_t of_offset;		/* current seek position */
+	int of_flags;			/* flags passed to open */
+	int of_refcount;		/* number of descriptors using us */
+	struct lock *of_lock;		/* protects of_offset */
+};
+
+struct filetable {
+	struct openfile *ft_files[OPEN_MAX];
+};
+
+/*
+ * Functions:
+ *     openfile_create  - wrap an open vnode in an openfile with one
+ *                        reference.
+ *     openfile_open    - vfs_open PATH and wrap it in an openfile with
+ *                        one reference. PATH may be modified.
+ *     openfile_incref  - add a reference to an openfile.
+ *     openfile_decref  - drop a reference; the last one closes the file.
+ *     filetable_create - make an empty descriptor table.
+ *     filetable_stdio  - open the console on descriptors 0, 1 and 2.
+ *     filetable_copy   - make a new table sharing all the openfiles of
+ *                        an old one (for fork).
+ *     filetable_destroy - close every descriptor and free the table.
+ *     filetable_get    - look up descriptor FD. Returns EBADF if it
+ *                        isn't open.
+ *     filetable_place  - put an openfile in the lowest free descriptor,
+ *                        taking over the caller's reference.
+ *     filetable_close  - close descriptor FD.
+ *     filetable_dup2   - make NEWFD refer to the same openfile as OLDFD.
+ */
+
+int openfile_create(struct vnode *vn, int flags, struct openfile **ret);
+int openfile_open(char *path, int flags, struct openfile **ret);
+void openfile_incref(struct openfile *of);
+void openfile_decref(struct openfile *of);
+
+struct filetable *filetable_create(void);
+int filetable_stdio(struct filetable *ft);
+struct filetable *filetable_copy(struct filetable *ft);
+void filetable_destroy(struct filetable *ft);
+
+int filetable_get(struct filetable *ft, int fd, struct openfile **ret);
+int filetable_place(struct filetable *ft, struct openfile *of, int *fd);
+int filetable_close(struct filetable *ft, int fd);
+int filetable_dup2(struct filetable *ft, int oldfd, int newfd);
+
+#endif /* _FILE_H_ */
@@ -0,0 +1,34 @@
+#ifndef _KERN_CLOCKPAGE_H_
+#define _KERN_CLOCKPAGE_H_
+
+/*
+ * The clock page.
+ *
+ * The kernel maps one read-only page at CLOCKPAGE_ADDR into every
+ * user address space and updates it on every clock tick, so programs
+ * can tell the time without a system call.
+ *
+ * The kernel makes cp_seq odd before changing the other fields and
+ * even again afterwards. To read consistently, take cp_seq, read what
+ * you need, and start over if cp_seq was odd or has since changed:
+ *
+ *     do {
+ *         seq = cp->cp_seq;
+ *         secs = cp->cp_secs;
+ *     } while ((seq & 1) || cp->cp_seq != seq);
+ */
+
+/* Just below the stack, clear of anything else in the address space */
+#define CLOCKPAGE_ADDR  0x7ff00000
+
+struct clockpage {
+	volatile u_int32_t cp_seq;	/* update counter, odd while changing */
+	volatile time_t cp_secs;	/* time of day at the last tick */
+	volatile u_int32_t cp_nsecs;
+	volatile u_int32_t cp_ticks;	/* clock ticks since boot */
+	u_int32_t cp_hz;		/* clock ticks per second */
+};
+
+#define CLOCKPAGE  ((const struct clockpage *)CLOCKPAGE_ADDR)
+
+#endif /* _KERN_CLOCKPAGE_H_ */
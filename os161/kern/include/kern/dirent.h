@@ -0,0 +1,49 @@
+#ifndef _KERN_DIRENT_H_
+#define _KERN_DIRENT_H_
+
+/*
+ * Directory entries as returned by getdirentries().
+ *
+ * getdirentries() packs as many entries as fit into the caller's
+ * buffer, one after another. Each takes d_reclen bytes: the fixed
+ * fields, then the name and its terminating NUL, rounded up so the
+ * next entry is aligned. Walk the buffer by adding d_reclen; don't
+ * use sizeof(struct dirent).
+ *
+ * The position to resume from (the "cookie") is only meaningful to
+ * the filesystem. Start with 0 and pass back whatever the previous
+ * call handed out.
+ */
+
+#include <kern/limits.h>
+
+struct dirent {
+	u_int32_t d_ino;		/* inode number, or 0 if unknown */
+	u_int16_t d_reclen;		/* bytes taken by this entry */
+	u_int8_t d_type;		/* DT_* below */
+	u_int8_t d_namlen;		/* length of d_name, without the NUL */
+	char d_name[NAME_MAX+1];	/* only d_namlen+1 bytes are used */
+};
+
+/* Size of the fixed part of an entry */
+#define DIRENT_HDRSIZE  (sizeof(struct dirent) - (NAME_MAX+1))
+
+/* Space taken by an entry with a name of NAMLEN characters */
+#define DIRENT_RECLEN(namlen) \
+	((DIRENT_HDRSIZE + (namlen) + 1 + 3) & ~3)
+
+/*
+ * Values for d_type. These are the S_IF* file types from kern/stat.h
+ * shifted down, so DT_TYPE(S_IFDIR) == DT_DIR.
+ */
+#define DT_UNKNOWN  0
+#define DT_REG      1
+#define DT_DIR      2
+#define DT_LNK      3
+#define DT_CHR      4
+#define DT_BLK      5
+#define DT_FIFO     6
+
+#define DT_TYPE(mode)  (((mode) & 070000) >> 12)
+
+#endif /* _KERN_DIRENT_H_ */
@@ -7,5 +7,14 @@
 /* Longest full path name */
 #define PATH_MAX   1024
 
+/* Number of file handles a process can have open at once */
+#define OPEN_MAX   32
+
+/* Most buffers that can be passed to readv or writev */
+#define IOV_MAX    16
+
+/* Writes to a pipe of at most this many bytes are atomic */
+#define PIPE_BUF   512
+
 
 #endif /* _KERN_LIMITS_H_ */
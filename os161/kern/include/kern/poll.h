@@ -0,0 +1,22 @@
+#ifndef _KERN_POLL_H_
+#define _KERN_POLL_H_
+
+/*
+ * Definitions for poll().
+ */
+
+struct pollfd {
+	int fd;			/* descriptor to check; ignored if negative */
+	short events;		/* what to wait for */
+	short revents;		/* what happened */
+};
+
+/* Events. POLLERR, POLLHUP and POLLNVAL are always reported. */
+#define POLLIN      0x0001	/* reading won't block */
+#define POLLPRI     0x0002	/* urgent data (never happens) */
+#define POLLOUT     0x0004	/* writing won't block */
+#define POLLERR     0x0008	/* error; for pipes, no reader is left */
+#define POLLHUP     0x0010	/* hung up: no writer is left */
+#define POLLNVAL    0x0020	/* fd is not open */
+
+#endif /* _KERN_POLL_H_ */
@@ -24,6 +24,35 @@
 /* Size of bitmap (in blocks) */
 #define SFS_BITBLOCKS(nblocks)  (SFS_BITMAPSIZE(nblocks)/SFS_BLOCKBITS)
 
+/*
+ * Feature flags for sp_features.
+ *
+ * SFS_FEATURE_HASHDIR: directories are hash tables. A directory is
+ * still an array of struct sfs_dir, but it is a power-of-two number of
+ * blocks long, and each block is one bucket. A name lives in the
+ * bucket given by the low bits of its FNV-1a hash (32-bit, over the
+ * characters of the name), so finding it takes one block read. A
+ * bucket that overflows doubles the directory, splitting every bucket
+ * b into b and b + the old bucket count. Free slots and unallocated
+ * blocks are empty (sfd_ino == SFS_NOINO).
+ *
+ * Code that only reads directories as a flat array of entries works
+ * the same on both layouts; code that adds entries must know about
+ * the hashed layout.
+ */
+#define SFS_FEATURE_HASHDIR  0x00000001
+
+/*
+ * SFS_FEATURE_EXTENTS: inodes map their blocks with a list of extents
+ * (struct sfs_xinode below) instead of direct and indirect block
+ * pointers. The extents cover the file's blocks in order; an extent
+ * with sx_start 0 is a hole.
+ */
+#define SFS_FEATURE_EXTENTS  0x00000002
+
+/* All the features this version knows about */
+#define SFS_FEATURES_KNOWN   (SFS_FEATURE_HASHDIR | SFS_FEATURE_EXTENTS)
+
 /* File types for dfi_type */
 #define SFS_TYPE_INVAL    0       /* Should not appear on disk */
 #define SFS_TYPE_FILE     1
@@ -36,7 +65,8 @@ struct sfs_super {
 	u_int32_t sp_magic;       /* Magic number, should be SFS_MAGIC */
 	u_int32_t sp_nblocks;     /* Number of blocks in fs */
 	char sp_volname[SFS_VOLNAME_SIZE];  /* Name of this volume */
-	u_int32_t reserved[118];
+	u_int32_t sp_features;    /* SFS_FEATURE_* flags */
+	u_int32_t reserved[117];
 };
 
 /*
@@ -48,7 +78,29 @@ struct sfs_inode {
 	u_int16_t sfi_linkcount;   /* Number of hard links to this file */
 	u_int32_t sfi_direct[SFS_NDIRECT];	/* Direct blocks */
 	u_int32_t sfi_indirect;			/* Indirect block */
-	u_int32_t sfi_waste[128-3-SFS_NDIRECT]; /* unused space */
+	u_int32_t sfi_dindirect;		/* Double indirect block */
+	u_int32_t sfi_tindirect;		/* Triple indirect block */
+	u_int32_t sfi_waste[128-5-SFS_NDIRECT]; /* unused space */
+};
+
+/*
+ * On-disk inode on filesystems with SFS_FEATURE_EXTENTS. The first
+ * three fields are the same as in struct sfs_inode.
+ */
+#define SFS_NEXTENTS      62            /* # of extents in inode */
+
+struct sfs_extent {
+	u_int32_t sx_start;        /* First disk block, or 0 for a hole */
+	u_int32_t sx_len;          /* Number of blocks */
+};
+
+struct sfs_xinode {
+	u_int32_t sxi_size;        /* Size of this file (bytes) */
+	u_int16_t sxi_type;        /* One of SFS_TYPE_* above */
+	u_int16_t sxi_linkcount;   /* Number of hard links to this file */
+	u_int32_t sxi_nextents;    /* Number of extents in use */
+	struct sfs_extent sxi_extents[SFS_NEXTENTS];
+	u_int32_t sxi_waste[1];    /* unused space */
 };
 
 /*
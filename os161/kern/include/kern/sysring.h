@@ -0,0 +1,57 @@
+#ifndef _KERN_SYSRING_H_
+#define _KERN_SYSRING_H_
+
+/*
+ * System call batching rings.
+ *
+ * A process puts requests on the submission queue (sq) and calls
+ * sysring_enter(), which runs as many of them as it can in one trap and
+ * posts a result for each on the completion queue (cq). The ring lives
+ * in the process's own memory and the kernel works on it in place, so
+ * neither side copies the queues.
+ *
+ * Indexes run freely and are reduced mod SYSRING_ENTRIES when used.
+ * The process advances sq_tail and cq_head; the kernel advances sq_head
+ * and cq_tail. The kernel stops early if the completion queue fills up.
+ */
+
+#define SYSRING_ENTRIES  32		/* must be a power of 2 */
+#define SYSRING_MASK     (SYSRING_ENTRIES - 1)
+
+/* Operations */
+#define SYSRING_OP_NOP     0
+#define SYSRING_OP_READ    1		/* read(fd, buf, len) */
+#define SYSRING_OP_WRITE   2		/* write(fd, buf, len) */
+#define SYSRING_OP_PREAD   3		/* pread(fd, buf, len, off) */
+#define SYSRING_OP_PWRITE  4		/* pwrite(fd, buf, len, off) */
+#define SYSRING_OP_OPEN    5		/* open(buf, flags) */
+#define SYSRING_OP_CLOSE   6		/* close(fd) */
+
+/* Submission queue entry */
+struct sysring_sqe {
+	int op;				/* SYSRING_OP_* */
+	int fd;				/* file handle */
+	void *buf;			/* buffer, or path for open */
+	size_t len;			/* buffer length */
+	off_t off;			/* offset for pread/pwrite */
+	int flags;			/* flags for open */
+	u_int32_t user_data;		/* handed back in the completion */
+};
+
+/* Completion queue entry */
+struct sysring_cqe {
+	u_int32_t user_data;		/* from the submission */
+	int result;			/* what the call would have returned */
+	int error;			/* errno value, or 0 */
+};
+
+struct sysring {
+	volatile u_int32_t sq_head;
+	volatile u_int32_t sq_tail;
+	volatile u_int32_t cq_head;
+	volatile u_int32_t cq_tail;
+	struct sysring_sqe sq[SYSRING_ENTRIES];
+	struct sysring_cqe cq[SYSRING_ENTRIES];
+};
+
+#endif /* _KERN_SYSRING_H_ */
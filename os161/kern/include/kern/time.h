@@ -0,0 +1,22 @@
+#ifndef _KERN_TIME_H_
+#define _KERN_TIME_H_
+
+/*
+ * Time interval, as used by nanosleep.
+ */
+
+struct timespec {
+	time_t tv_sec;		/* seconds */
+	u_int32_t tv_nsec;	/* nanoseconds, less than 1000000000 */
+};
+
+/*
+ * Time interval, as used by select.
+ */
+
+struct timeval {
+	time_t tv_sec;		/* seconds */
+	u_int32_t tv_usec;	/* microseconds, less than 1000000 */
+};
+
+#endif /* _KERN_TIME_H_ */
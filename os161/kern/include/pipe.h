@@ -0,0 +1,30 @@
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+/*
+ * Pipes.
+ *
+ * A pipe is a pair of vnodes, one for each end, sharing a ring buffer
+ * of PIPE_PAGES pages. Reads block until there is data or the write end
+ * is closed (end of file); writes block until there is room, and fail
+ * with EPIPE once the read end is closed. Writes of at most PIPE_BUF
+ * bytes are never interleaved with other writes.
+ *
+ * Large writes from user space don't go through the ring buffer:
+ * instead, the writer lends its buffer to the pipe and waits, and
+ * readers copy straight out of the writer's pages. This saves copying
+ * the data twice.
+ *
+ * Functions:
+ *     pipe_create - make a new pipe and return vnodes for its read and
+ *                   write ends. Each comes back open once, so it can be
+ *                   put in an openfile and released with vfs_close.
+ */
+
+#define PIPE_PAGES   4
+
+struct vnode;
+
+int pipe_create(struct vnode **readvn, struct vnode **writevn);
+
+#endif /* _PIPE_H_ */
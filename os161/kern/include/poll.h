@@ -0,0 +1,22 @@
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Waiting for I/O readiness (poll, and select in libc).
+ *
+ * VOP_POLL reports which events an object is ready for right now. To
+ * wait, sys_poll sleeps until poll_wakeup is called and then asks all
+ * its descriptors again. There is one wait channel for all pollers,
+ * since a thread can only sleep on one address at a time; anything
+ * that makes an object ready (console input, pipe reads, writes and
+ * closes) calls poll_wakeup after it wakes its own waiters.
+ *
+ * Functions:
+ *     poll_wakeup - something may have become ready; make sleeping
+ *                   pollers look again. Can be called from an
+ *                   interrupt handler.
+ */
+
+void poll_wakeup(void);
+
+#endif /* _POLL_H_ */
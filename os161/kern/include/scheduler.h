@@ -8,6 +8,8 @@
  *     make_runnable - add the specified thread to the run queue. If it's
  *                     already on the run queue or sleeping, weird things
  *                     may happen. Returns an error code.
+ *     scheduler_hasrunnable - return nonzero if any thread is waiting
+ *                     on the run queue.
  *
  *     print_run_queue - dump the run queue to the console for debugging.
  *
@@ -22,6 +24,7 @@ struct thread;
 
 struct thread *scheduler(void);
 int make_runnable(struct thread *t);
+int scheduler_hasrunnable(void);
 
 void print_run_queue(void);
 
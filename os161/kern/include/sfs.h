@@ -18,14 +18,32 @@ struct sfs_vnode {
 	struct sfs_inode sv_i;		/* on-disk inode */
 	u_int32_t sv_ino;               /* inode number */
 	int sv_dirty;                   /* true if sv_i modified */
+	struct sfs_vnode *sv_hashnext;  /* next in sfs_vnhash chain */
+	struct sfs_vnode *sv_dirtyprev; /* sfs_dirtyvnodes list links */
+	struct sfs_vnode *sv_dirtynext;
+	u_int32_t sv_rsvstart;          /* blocks set aside for appending */
+	u_int32_t sv_rsvcount;          /* (number of them) */
+	u_int32_t sv_idbase;            /* first file block mapped by */
+	u_int32_t sv_idblock;           /* this indirect block, or 0 */
+	u_int32_t sv_ranext;            /* block the next sequential read
+					   starts in */
+	u_int32_t sv_rawindow;          /* read-ahead window (blocks) */
+	u_int32_t sv_raend;             /* blocks read ahead up to here */
 };
 
+/* Number of chains in the loaded-vnode hash table */
+#define SFS_VNHASHSIZE  61
+
 struct sfs_fs {
 	struct fs sfs_absfs;            /* abstract filesystem structure */
 	struct sfs_super sfs_super;	/* on-disk superblock */
 	int sfs_superdirty;             /* true if superblock modified */
 	struct device *sfs_device;      /* device mounted on */
-	struct array *sfs_vnodes;       /* vnodes loaded into memory */
+	struct sfs_vnode *sfs_vnhash[SFS_VNHASHSIZE];
+					/* vnodes loaded into memory,
+					   hashed by inode number */
+	int sfs_nvnodes;                /* number of vnodes loaded */
+	struct sfs_vnode *sfs_dirtyvnodes; /* loaded vnodes with sv_dirty */
 	struct bitmap *sfs_freemap;     /* blocks in use are marked 1 */
 	int sfs_freemapdirty;           /* true if freemap modified */
 };
@@ -40,15 +58,13 @@ int sfs_mount(const char *device);
  * Internal functions
  */
 
-/* Initialize uio structure */
-#define SFSUIO(uio, ptr, block, rw) \
-    mk_kuio(uio, ptr, SFS_BLOCKSIZE, ((off_t)(block))*SFS_BLOCKSIZE, rw)
-
-/* Convenience functions for block I/O */
-int sfs_rwblock(struct sfs_fs *sfs, struct uio *uio);
+/* Convenience functions for block I/O (through the buffer cache) */
 int sfs_rblock(struct sfs_fs *sfs, void *data, u_int32_t block);
 int sfs_wblock(struct sfs_fs *sfs, void *data, u_int32_t block);
 
+/* Write a loaded vnode's inode, if changed, to the buffer cache */
+int sfs_sync_inode(struct sfs_vnode *sv);
+
 /* Get root vnode */
 struct vnode *sfs_getroot(struct fs *fs);
 
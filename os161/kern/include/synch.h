@@ -74,6 +74,8 @@ void         lock_destroy(struct lock *);
  *                   waking up again, re-acquire the lock.
  *    cv_signal    - Wake up one thread that's sleeping on this CV.
  *    cv_broadcast - Wake up all threads sleeping on this CV.
+ *    cv_timedwait - Like cv_wait, but give up after TICKS clock ticks.
+ *                   Returns 0 if signalled, or ETIMEDOUT.
  *
  * For all three operations, the current thread must hold the lock passed 
  * in. Note that under normal circumstances the same lock should be used
@@ -98,6 +100,7 @@ struct cv *cv_create(const char *name);
 void       cv_wait(struct cv *cv, struct lock *lock);
 void       cv_signal(struct cv *cv, struct lock *lock);
 void       cv_broadcast(struct cv *cv, struct lock *lock);
+int        cv_timedwait(struct cv *cv, struct lock *lock, u_int32_t ticks);
 void       cv_destroy(struct cv *);
 
 #endif /* _SYNCH_H_ */
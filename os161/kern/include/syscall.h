@@ -1,6 +1,17 @@
 #ifndef _SYSCALL_H_
 #define _SYSCALL_H_
 
+struct timespec;
+struct iovec;
+struct sysring;
+struct pollfd;
+
+/*
+ * Print or clear the per-system-call counts and latency histograms.
+ */
+void syscall_printstats(void);
+void syscall_resetstats(void);
+
 /*
  * Prototypes for IN-KERNEL entry points for system call implementations.
  */
@@ -8,6 +19,23 @@
 int sys_reboot(int code);
 int sys_print(int fd, userptr_t *buf, size_t nbytes, int32_t *retval);
 int sys_read(int fd, userptr_t *buf, size_t buflen, int32_t *retval);
+int sys_pread(int fd, userptr_t *buf, size_t buflen, off_t pos, int32_t *retval);
+int sys_pwrite(int fd, userptr_t *buf, size_t nbytes, off_t pos, int32_t *retval);
+int sys_readv(int fd, const struct iovec *iov, int iovcnt, int32_t *retval);
+int sys_writev(int fd, const struct iovec *iov, int iovcnt, int32_t *retval);
+int sys_open(const char *path, int flags, int32_t *retval);
+int sys_close(int fd);
+int sys_fsync(int fd);
+int sys_sysring_enter(struct sysring *ring, int32_t *retval);
+int sys_poll(struct pollfd *fds, int nfds, int timeout, int32_t *retval);
+int sys_pipe(int *fds);
+int sys_copy_file_range(int infd, int outfd, size_t len, int32_t *retval);
+int sys_remove(const char *path);
+int sys_rename(const char *oldpath, const char *newpath);
+int sys_lseek(int fd, off_t pos, int whence, int32_t *retval);
+int sys_dup2(int oldfd, int newfd, int32_t *retval);
+int sys_getdirentry(int fd, userptr_t *buf, size_t buflen, int32_t *retval);
+int sys_getdirentries(int fd, userptr_t *buf, size_t buflen, off_t *cookie, int32_t *retval);
 int sys_fork(struct trapframe *tf, int32_t *retval);
 void child_fork(struct trapframe *tf, unsigned long address_space);
 int sys_getpid(pid_t *retval);
@@ -15,6 +43,8 @@ int sys_waitpid(pid_t t_pid, int *status, int options, pid_t *retval);
 int sys__exit(int exitcode);
 int sys_execv(const char *program, char **args, int32_t *retval);
 int sys_sbrk(intptr_t amount, int32_t *retval);
+int sys_nanosleep(const struct timespec *req, struct timespec *rem);
+int sys___time(time_t *secs, unsigned long *nsecs, int32_t *retval);
 
 
 #endif /* _SYSCALL_H_ */
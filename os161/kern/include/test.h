@@ -27,6 +27,7 @@ int threadtest3(int, char **);
 int semtest(int, char **);
 int locktest(int, char **);
 int cvtest(int, char **);
+int callouttest(int, char **);
 
 /* filesystem tests */
 int fstest(int, char **);
@@ -8,10 +8,19 @@
 /* Get machine-dependent stuff */
 #include <machine/pcb.h>
 
- #define MAX_PIDS 512
+/*
+ * The pid table starts out with PID_INITIAL entries and is doubled as
+ * needed, up to PID_MAX.
+ */
+#define PID_INITIAL 32
+#define PID_MAX 32767
+
+/* Names shorter than this are kept in the thread itself. */
+#define THREAD_NAMELEN 32
 
 
 struct addrspace;
+struct filetable;
 
 struct thread {
 	/**********************************************************/
@@ -20,7 +29,11 @@ struct thread {
 	
 	struct pcb t_pcb;
 	char *t_name;
+	char t_namebuf[THREAD_NAMELEN];
 	const void *t_sleepaddr;
+	struct thread *t_sleepnext;	/* next on the sleepers list */
+	struct thread **t_sleepprev;	/* what points to us there */
+	int t_timedout;
 	char *t_stack;
 	
 	/**********************************************************/
@@ -40,6 +53,12 @@ struct thread {
 	 */
 	struct vnode *t_cwd;
 
+	/*
+	 * Open file descriptors. NULL for kernel-only threads; set up
+	 * when a program is run, and inherited across fork.
+	 */
+	struct filetable *t_filetable;
+
 	/*
 	 * This is a pid to keep track of threads.
 	 */
@@ -54,6 +73,9 @@ struct process {
     pid_t thread_pid;
     int has_waiters;
     struct semaphore *exit_semaphore;
+    struct process *children;		/* list of our children */
+    struct process *next_sibling;	/* next child of our parent */
+    struct process **prev_sibling;	/* link pointing to us */
 };
 
 /* Call once during startup to allocate data structures. */
@@ -65,6 +87,15 @@ void thread_panic(void);
 /* Call during shutdown to clean up (must be called by initial thread) */
 void thread_shutdown(void);
 
+/*
+ * Release cached thread structures and stacks to free up memory.
+ * Returns the number released. Called by kmalloc when it runs out.
+ */
+int thread_cache_shrink(void);
+
+/* Print thread cache and stack usage statistics. */
+void thread_printstats(void);
+
 /*
  * Make a new thread, which will start executing at "func".  The
  * "data" arguments (one pointer, one integer) are passed to the
@@ -101,6 +132,14 @@ void thread_yield(void);
  */
 void thread_sleep(const void *addr);
 
+/*
+ * Like thread_sleep, but give up after TICKS clock ticks (1/HZ
+ * seconds) if nobody has called wakeup. Returns 0 if woken up, or
+ * ETIMEDOUT if the time ran out.
+ * Interrupts must be disabled.
+ */
+int thread_sleep_timeout(const void *addr, u_int32_t ticks);
+
 /*
  * Cause all threads sleeping on the specified address to wake up.
  * Interrupts must be disabled.
@@ -140,10 +179,14 @@ struct process *pid_alloc(pid_t pid, pid_t p_pid);
 /* Deallocate a pid when the process dies */
 void pid_dealloc(pid_t t_pid);
 
-int pid_insert(pid_t parent, int32_t *retval);
+/* Allocate a pid for a new child of parent */
+int pid_insert(pid_t parent, pid_t *retval);
 
+/* Record the exit code of the current thread; safe to call twice */
 void pid_exit(unsigned exitcode);
 
+/* Wait for a child to exit and collect its exit code */
+
 int pid_wait(pid_t t_pid, int *status, int *retval);
 
 #endif /* _THREAD_H_ */
@@ -2,8 +2,13 @@
 #define _UIO_H_
 
 /*
- * Like BSD uio, but simplified a bit. (In BSD, there can be more than one
- * iovec in a uio.)
+ * Like BSD uio, but simplified a bit.
+ *
+ * A uio describes one or more buffers (iovecs) to be transferred in
+ * order. For the common case of a single buffer, the uio carries one
+ * iovec of its own in uio_iovec and uio_iov points at it; mk_kuio and
+ * mk_uuio set this up. For scatter/gather I/O, point uio_iov at an
+ * array of uio_iovcnt iovecs instead (see mk_uuiov).
  */
 
 enum uio_rw {
@@ -28,7 +33,9 @@ struct iovec {
 #define iov_ubase  iov_un.un_ubase
 
 struct uio {
-	struct iovec      uio_iovec;       /* Data block */
+	struct iovec     *uio_iov;         /* Data blocks */
+	int               uio_iovcnt;      /* Number of blocks in uio_iov */
+	struct iovec      uio_iovec;       /* Storage for a single block */
 	off_t             uio_offset;      /* desired offset into object */
 	size_t            uio_resid;       /* Remaining amt of data to xfer */
 	enum uio_seg      uio_segflg;      /* what kind of pointer we have */
@@ -43,7 +50,8 @@ struct uio {
  * fields as well.
  *
  * Before calling this, you should
- *   (1) set up uio_iovec to point to the buffer you want to transfer to;
+ *   (1) set up uio_iov and uio_iovcnt to point to the buffers you want
+ *       to transfer to;
  *   (2) initialize uio_offset as desired;
  *   (3) initialize uio_resid to the total amount of data that can be 
  *       transferred through this uio;
@@ -53,15 +61,15 @@ struct uio {
  *       should be found.
  *
  * After calling, 
- *   (1) the contents of uio_iovec may be altered and should not be 
- *       interpreted;
+ *   (1) uio_iov, uio_iovcnt, and the contents of the iovecs may be
+ *       altered and should not be interpreted;
  *   (2) uio_offset will have been incremented by the amount transferred;
  *   (3) uio_resid will have been decremented by the amount transferred;
  *   (4) uio_segflg, uio_rw, and uio_space will be unchanged.
  *
  * uiomove() may be called repeatedly on the same uio to transfer
  * additional data until the available buffer space the uio refers to
- * is exhausted.
+ * is exhausted. A single call may span several iovecs.
  *
  * Note that the actual value of uio_offset is not interpreted. It is
  * provided to allow for easier file seek pointer management.
@@ -88,4 +96,11 @@ void mk_kuio(struct uio *, void *kbuf, size_t len, off_t pos, enum uio_rw rw);
  */
 void mk_uuio(struct uio *uio, userptr_t *ubuf, size_t len, off_t pos, enum uio_rw rw);
 
+/*
+ * Initialize uio for I/O to or from IOVCNT user buffers described by
+ * the kernel array IOV, which must stay around for the duration of
+ * the I/O. uio_resid is set to the total length.
+ */
+void mk_uuiov(struct uio *uio, struct iovec *iov, int iovcnt, off_t pos, enum uio_rw rw);
+
 #endif /* _UIO_H_ */
@@ -41,6 +41,10 @@ void vm_bootstrap(void);
 /* Fault handling function called by trap code */
 int vm_fault(int faulttype, vaddr_t faultaddress);
 
+/* Find the physical address a user virtual address maps to */
+struct addrspace;
+int vm_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret);
+
 /* Allocate/free kernel heap pages (called by kmalloc/kfree) */
 vaddr_t alloc_kpages(int npages);
 void free_kpages(vaddr_t addr);
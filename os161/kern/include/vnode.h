@@ -82,6 +82,13 @@ struct vnode {
  *                      handled in the normal fashion.
  *                      On non-directory objects, return ENOTDIR.
  *
+ *    vop_getdirentries - Like vop_getdirentry, but pack as many entries
+ *                      as fit into the uio as struct dirent records
+ *                      (see kern/dirent.h), and leave the offset field
+ *                      at the first entry not returned. Return EINVAL
+ *                      if not even one entry fits.
+ *                      On non-directory objects, return ENOTDIR.
+ *
  *    vop_write       - Write data from uio to file at offset specified
  *                      in the uio, updating uio_resid to reflect the
  *                      amount written, and updating uio_offset to match.
@@ -97,6 +104,12 @@ struct vnode {
  *    vop_gettype     - Return type of file. The values for file types
  *                      are in kern/stat.h.
  *
+ *    vop_poll        - Set *REVENTS to those of the POLL* events in
+ *                      EVENTS (see kern/poll.h) that the object is
+ *                      ready for now, plus POLLERR or POLLHUP if they
+ *                      apply. Must not block. Objects that are always
+ *                      ready return EVENTS as is.
+ *
  *    vop_tryseek     - Check if seeking to the specified position within
  *                      the file is legal. (For instance, all seeks
  *                      are illegal on serial port devices, and seeks
@@ -174,10 +187,12 @@ struct vnode_ops {
 	int (*vop_read)(struct vnode *file, struct uio *uio);
 	int (*vop_readlink)(struct vnode *link, struct uio *uio);
 	int (*vop_getdirentry)(struct vnode *dir, struct uio *uio);
+	int (*vop_getdirentries)(struct vnode *dir, struct uio *uio);
 	int (*vop_write)(struct vnode *file, struct uio *uio);
 	int (*vop_ioctl)(struct vnode *object, int op, userptr_t data);
 	int (*vop_stat)(struct vnode *object, struct stat *statbuf);
 	int (*vop_gettype)(struct vnode *object, u_int32_t *result);
+	int (*vop_poll)(struct vnode *object, int events, int *revents);
 	int (*vop_tryseek)(struct vnode *object, off_t pos);
 	int (*vop_fsync)(struct vnode *object);
 	int (*vop_mmap)(struct vnode *file /* add stuff */);
@@ -219,10 +234,12 @@ struct vnode_ops {
 #define VOP_READ(vn, uio)               (__VOP(vn, read)(vn, uio))
 #define VOP_READLINK(vn, uio)           (__VOP(vn, readlink)(vn, uio))
 #define VOP_GETDIRENTRY(vn, uio)        (__VOP(vn,getdirentry)(vn, uio))
+#define VOP_GETDIRENTRIES(vn, uio)      (__VOP(vn,getdirentries)(vn, uio))
 #define VOP_WRITE(vn, uio)              (__VOP(vn, write)(vn, uio))
 #define VOP_IOCTL(vn, code, buf)        (__VOP(vn, ioctl)(vn,code,buf))
 #define VOP_STAT(vn, ptr) 	        (__VOP(vn, stat)(vn, ptr))
 #define VOP_GETTYPE(vn, result)         (__VOP(vn, gettype)(vn, result))
+#define VOP_POLL(vn, ev, rev)           (__VOP(vn, poll)(vn, ev, rev))
 #define VOP_TRYSEEK(vn, pos)            (__VOP(vn, tryseek)(vn, pos))
 #define VOP_FSYNC(vn)                   (__VOP(vn, fsync)(vn))
 #define VOP_MMAP(vn /*add stuff */)     (__VOP(vn, mmap)(vn /*add stuff */))
@@ -93,6 +93,62 @@ bitmap_alloc(struct bitmap *b, u_int32_t *index)
 	return ENOSPC;
 }
 
+/*
+ * Search forward from GOAL. Full words are skipped a byte at a time,
+ * and four at a time where the bytes are aligned for it; the bit data
+ * stays in bytes so the on-disk layout doesn't change.
+ */
+int
+bitmap_alloc_near(struct bitmap *b, u_int32_t goal, u_int32_t *index)
+{
+	u_int32_t maxix = DIVROUNDUP(b->nbits, BITS_PER_WORD);
+	u_int32_t ix, n;
+	u_int32_t offset;
+
+	if (goal >= b->nbits) {
+		goal = 0;
+	}
+
+	/* The rest of the goal's own word */
+	ix = goal / BITS_PER_WORD;
+	for (offset = goal % BITS_PER_WORD; offset < BITS_PER_WORD; offset++) {
+		WORD_TYPE mask = ((WORD_TYPE)1)<<offset;
+		if ((b->v[ix] & mask)==0) {
+			b->v[ix] |= mask;
+			*index = (ix*BITS_PER_WORD)+offset;
+			assert(*index < b->nbits);
+			return 0;
+		}
+	}
+
+	/* Then the following words, coming back around to the goal's */
+	for (n=1; n<=maxix; n++) {
+		ix = (goal / BITS_PER_WORD + n) % maxix;
+
+		if (ix % sizeof(u_int32_t) == 0 &&
+		    ix + sizeof(u_int32_t) <= maxix &&
+		    n + sizeof(u_int32_t) - 1 <= maxix &&
+		    *(u_int32_t *)&b->v[ix] == 0xffffffff) {
+			n += sizeof(u_int32_t) - 1;
+			continue;
+		}
+
+		if (b->v[ix]!=WORD_ALLBITS) {
+			for (offset = 0; offset < BITS_PER_WORD; offset++) {
+				WORD_TYPE mask = ((WORD_TYPE)1)<<offset;
+				if ((b->v[ix] & mask)==0) {
+					b->v[ix] |= mask;
+					*index = (ix*BITS_PER_WORD)+offset;
+					assert(*index < b->nbits);
+					return 0;
+				}
+			}
+			assert(0);
+		}
+	}
+	return ENOSPC;
+}
+
 static
 inline
 void
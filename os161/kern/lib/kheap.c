@@ -1,6 +1,7 @@
 #include <types.h>
 #include <lib.h>
 #include <vm.h>
+#include <thread.h>
 #include <machine/spl.h>
 
 static
@@ -545,6 +546,8 @@ subpage_kfree(void *ptr)
 void *
 kmalloc(size_t sz)
 {
+	void *ptr;
+
 	if (sz>=LARGEST_SUBPAGE_SIZE) {
 		unsigned long npages;
 		vaddr_t address;
@@ -552,6 +555,10 @@ kmalloc(size_t sz)
 		/* Round up to a whole number of pages. */
 		npages = (sz + PAGE_SIZE - 1)/PAGE_SIZE;
 		address = alloc_kpages(npages);
+		if (address==0 && thread_cache_shrink() > 0) {
+			/* Try again with the cached thread stacks given back. */
+			address = alloc_kpages(npages);
+		}
 		if (address==0) {
 			return NULL;
 		}
@@ -559,7 +566,11 @@ kmalloc(size_t sz)
 		return (void *)address;
 	}
 
-	return subpage_kmalloc(sz);
+	ptr = subpage_kmalloc(sz);
+	if (ptr==NULL && thread_cache_shrink() > 0) {
+		ptr = subpage_kmalloc(sz);
+	}
+	return ptr;
 }
 
 void
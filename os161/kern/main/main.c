@@ -16,6 +16,7 @@
 #include <dev.h>
 #include <vfs.h>
 #include <vm.h>
+#include <clock.h>
 #include <syscall.h>
 #include <version.h>
 
@@ -80,6 +81,7 @@ boot(void)
 	vfs_bootstrap();
 	dev_bootstrap();
 	vm_bootstrap();
+	clockpage_bootstrap();
 	kprintf_bootstrap();
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
@@ -13,6 +13,8 @@
 #include <uio.h>
 #include <vfs.h>
 #include <sfs.h>
+#include <buf.h>
+#include <dcache.h>
 #include <test.h>
 #include "opt-synchprobs.h"
 #include "opt-sfs.h"
@@ -348,6 +350,76 @@ cmd_kheapstats(int nargs, char **args)
 	return 0;
 }
 
+static
+int
+cmd_threadstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	thread_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_hardclockstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	hardclock_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_bufstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	buf_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_dcachestats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	dcache_printstats();
+
+	return 0;
+}
+
+/*
+ * Command for printing system call statistics, or with "reset",
+ * clearing them.
+ */
+static
+int
+cmd_syscallstats(int nargs, char **args)
+{
+	if (nargs == 2 && !strcmp(args[1], "reset")) {
+		syscall_resetstats();
+		return 0;
+	}
+	if (nargs != 1) {
+		kprintf("Usage: sc [reset]\n");
+		return EINVAL;
+	}
+
+	syscall_printstats();
+
+	return 0;
+}
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -419,6 +491,7 @@ static const char *testmenu[] = {
 	"[sy1] Semaphore test                ",
 	"[sy2] Lock test             (1)     ",
 	"[sy3] CV test               (1)     ",
+	"[ct]  Callout/timer wheel test      ",
 	"[fs1] Filesystem test               ",
 	"[fs2] FS read stress        (4)     ",
 	"[fs3] FS write stress       (4)     ",
@@ -489,6 +562,11 @@ static const char *mainmenu[] = {
 	"[1c] Stoplight                      ",
 #endif
 	"[kh] Kernel heap stats              ",
+	"[hc] Clock and context switch stats ",
+	"[ts] Thread cache and stack stats   ",
+	"[bc] Buffer cache stats             ",
+	"[dc] Name cache stats               ",
+	"[sc] System call stats [reset]      ",
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -707,6 +785,11 @@ static struct {
 
 	/* stats */
 	{ "kh",         cmd_kheapstats },
+	{ "hc",         cmd_hardclockstats },
+	{ "ts",         cmd_threadstats },
+	{ "bc",         cmd_bufstats },
+	{ "dc",         cmd_dcachestats },
+	{ "sc",         cmd_syscallstats },
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -725,6 +808,7 @@ static struct {
 	/* synchronization assignment tests */
 	{ "sy2",	locktest },
 	{ "sy3",	cvtest },
+	{ "ct",		callouttest },
 
 	/* file system assignment tests */
 	{ "fs1",	fstest },
@@ -0,0 +1,235 @@
+/*
+ * Open file objects and per-process file descriptor tables.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/unistd.h>
+#include <lib.h>
+#include <machine/spl.h>
+#include <synch.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <file.h>
+
+/*
+ * Wrap an open vnode in an openfile. On success the openfile takes over
+ * the caller's open reference to the vnode.
+ */
+int
+openfile_create(struct vnode *vn, int flags, struct openfile **ret)
+{
+	struct openfile *of;
+
+	of = kmalloc(sizeof(struct openfile));
+	if (of == NULL) {
+		return ENOMEM;
+	}
+
+	of->of_lock = lock_create("openfile");
+	if (of->of_lock == NULL) {
+		kfree(of);
+		return ENOMEM;
+	}
+
+	of->of_vnode = vn;
+	of->of_offset = 0;
+	of->of_flags = flags;
+	of->of_refcount = 1;
+
+	*ret = of;
+	return 0;
+}
+
+/*
+ * Open PATH and make an openfile for it.
+ */
+int
+openfile_open(char *path, int flags, struct openfile **ret)
+{
+	struct vnode *vn;
+	int result;
+
+	result = vfs_open(path, flags, &vn);
+	if (result) {
+		return result;
+	}
+
+	result = openfile_create(vn, flags, ret);
+	if (result) {
+		vfs_close(vn);
+		return result;
+	}
+	return 0;
+}
+
+void
+openfile_incref(struct openfile *of)
+{
+	int s = splhigh();
+	of->of_refcount++;
+	splx(s);
+}
+
+/*
+ * Drop a reference, and close the file when the last one goes.
+ */
+void
+openfile_decref(struct openfile *of)
+{
+	int s, last;
+
+	s = splhigh();
+	assert(of->of_refcount > 0);
+	of->of_refcount--;
+	last = (of->of_refcount == 0);
+	splx(s);
+
+	if (last) {
+		vfs_close(of->of_vnode);
+		lock_destroy(of->of_lock);
+		kfree(of);
+	}
+}
+
+struct filetable *
+filetable_create(void)
+{
+	struct filetable *ft;
+	int i;
+
+	ft = kmalloc(sizeof(struct filetable));
+	if (ft == NULL) {
+		return NULL;
+	}
+	for (i=0; i<OPEN_MAX; i++) {
+		ft->ft_files[i] = NULL;
+	}
+	return ft;
+}
+
+/*
+ * Set up stdin, stdout, and stderr on the console. Each gets its own
+ * openfile, as if the program had opened them itself.
+ */
+int
+filetable_stdio(struct filetable *ft)
+{
+	static const int modes[3] = { O_RDONLY, O_WRONLY, O_WRONLY };
+	char path[8];
+	struct openfile *of;
+	int fd, result;
+
+	for (fd=STDIN_FILENO; fd<=STDERR_FILENO; fd++) {
+		if (ft->ft_files[fd] != NULL) {
+			continue;
+		}
+
+		/* vfs_open destroys the path, so use a fresh copy each time */
+		strcpy(path, "con:");
+		result = openfile_open(path, modes[fd], &of);
+		if (result) {
+			return result;
+		}
+		ft->ft_files[fd] = of;
+	}
+	return 0;
+}
+
+struct filetable *
+filetable_copy(struct filetable *ft)
+{
+	struct filetable *newft;
+	int i;
+
+	newft = filetable_create();
+	if (newft == NULL) {
+		return NULL;
+	}
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] != NULL) {
+			openfile_incref(ft->ft_files[i]);
+			newft->ft_files[i] = ft->ft_files[i];
+		}
+	}
+	return newft;
+}
+
+void
+filetable_destroy(struct filetable *ft)
+{
+	int i;
+
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] != NULL) {
+			openfile_decref(ft->ft_files[i]);
+			ft->ft_files[i] = NULL;
+		}
+	}
+	kfree(ft);
+}
+
+int
+filetable_get(struct filetable *ft, int fd, struct openfile **ret)
+{
+	if (ft == NULL || fd < 0 || fd >= OPEN_MAX || ft->ft_files[fd] == NULL) {
+		return EBADF;
+	}
+	*ret = ft->ft_files[fd];
+	return 0;
+}
+
+int
+filetable_place(struct filetable *ft, struct openfile *of, int *fd)
+{
+	int i;
+
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] == NULL) {
+			ft->ft_files[i] = of;
+			*fd = i;
+			return 0;
+		}
+	}
+	return EMFILE;
+}
+
+int
+filetable_close(struct filetable *ft, int fd)
+{
+	struct openfile *of;
+	int result;
+
+	result = filetable_get(ft, fd, &of);
+	if (result) {
+		return result;
+	}
+	ft->ft_files[fd] = NULL;
+	openfile_decref(of);
+	return 0;
+}
+
+int
+filetable_dup2(struct filetable *ft, int oldfd, int newfd)
+{
+	struct openfile *of;
+	int result;
+
+	result = filetable_get(ft, oldfd, &of);
+	if (result) {
+		return result;
+	}
+	if (newfd < 0 || newfd >= OPEN_MAX) {
+		return EBADF;
+	}
+	if (oldfd == newfd) {
+		return 0;
+	}
+
+	openfile_incref(of);
+	if (ft->ft_files[newfd] != NULL) {
+		openfile_decref(ft->ft_files[newfd]);
+	}
+	ft->ft_files[newfd] = of;
+	return 0;
+}
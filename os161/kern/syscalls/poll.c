@@ -0,0 +1,174 @@
+/*
+ * poll(). See poll.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+#include <lib.h>
+#include <machine/spl.h>
+#include <thread.h>
+#include <curthread.h>
+#include <clock.h>
+#include <vnode.h>
+#include <file.h>
+#include <poll.h>
+#include <syscall.h>
+
+/*
+ * Bumped by every poll_wakeup. A poller notes it before checking its
+ * descriptors and only goes to sleep if it hasn't changed since, so a
+ * wakeup that lands in between isn't lost.
+ */
+static u_int32_t poll_gen;
+
+/* Number of threads asleep in sys_poll */
+static int poll_nsleeping;
+
+void
+poll_wakeup(void)
+{
+	int s = splhigh();
+
+	poll_gen++;
+	if (poll_nsleeping > 0) {
+		thread_wakeup(&poll_gen);
+	}
+	splx(s);
+}
+
+/*
+ * Fill in revents for each descriptor. Returns how many have something
+ * to report.
+ */
+static
+int
+poll_scan(struct pollfd *fds, int nfds)
+{
+	struct openfile *of;
+	int i, n = 0, revents;
+
+	for (i=0; i<nfds; i++) {
+		fds[i].revents = 0;
+		if (fds[i].fd < 0) {
+			continue;
+		}
+
+		if (filetable_get(curthread->t_filetable, fds[i].fd, &of)) {
+			revents = POLLNVAL;
+		}
+		else if (VOP_POLL(of->of_vnode, fds[i].events, &revents)) {
+			revents = POLLERR;
+		}
+
+		fds[i].revents = revents & (fds[i].events|POLLERR|POLLHUP|POLLNVAL);
+		if (fds[i].revents != 0) {
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ * Number of clock ticks from now until the deadline, or 0 if it has
+ * passed.
+ */
+static
+u_int32_t
+poll_ticksleft(time_t dsecs, u_int32_t dnsecs)
+{
+	time_t secs, rsecs;
+	u_int32_t nsecs, rnsecs;
+
+	gettime(&secs, &nsecs);
+	if (secs > dsecs || (secs == dsecs && nsecs >= dnsecs)) {
+		return 0;
+	}
+	getinterval(secs, nsecs, dsecs, dnsecs, &rsecs, &rnsecs);
+	return rsecs * HZ + DIVROUNDUP(rnsecs, 1000000000 / HZ);
+}
+
+/*
+ * Wait until one of the descriptors in FDS is ready, or TIMEOUT
+ * milliseconds have passed. A negative TIMEOUT waits forever; zero
+ * just checks.
+ */
+int
+sys_poll(struct pollfd *ufds, int nfds, int timeout, int32_t *retval)
+{
+	struct pollfd *fds;
+	time_t dsecs = 0;
+	u_int32_t dnsecs = 0, gen, ticks = 0;
+	int n, s, result, timedout = 0;
+
+	if (nfds < 0 || nfds > OPEN_MAX) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	/* Allocate at least one, so poll(NULL, 0, ms) works as a sleep */
+	fds = kmalloc((nfds > 0 ? nfds : 1) * sizeof(struct pollfd));
+	if (fds == NULL) {
+		*retval = -1;
+		return ENOMEM;
+	}
+	result = copyin((const_userptr_t)ufds, fds,
+			nfds * sizeof(struct pollfd));
+	if (result) {
+		kfree(fds);
+		*retval = -1;
+		return result;
+	}
+
+	/* Work out when to give up */
+	if (timeout > 0) {
+		gettime(&dsecs, &dnsecs);
+		dsecs += timeout / 1000;
+		dnsecs += (timeout % 1000) * 1000000;
+		if (dnsecs >= 1000000000) {
+			dnsecs -= 1000000000;
+			dsecs++;
+		}
+	}
+
+	while (1) {
+		gen = poll_gen;
+
+		n = poll_scan(fds, nfds);
+		if (n > 0 || timeout == 0 || timedout) {
+			break;
+		}
+
+		if (timeout > 0) {
+			ticks = poll_ticksleft(dsecs, dnsecs);
+			if (ticks == 0) {
+				break;
+			}
+		}
+
+		s = splhigh();
+		if (gen == poll_gen) {
+			poll_nsleeping++;
+			if (timeout < 0) {
+				thread_sleep(&poll_gen);
+			}
+			else if (thread_sleep_timeout(&poll_gen, ticks)) {
+				/* Look once more, then give up */
+				timedout = 1;
+			}
+			poll_nsleeping--;
+		}
+		splx(s);
+	}
+
+	result = copyout(fds, (userptr_t)ufds, nfds * sizeof(struct pollfd));
+	kfree(fds);
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = n;
+	return 0;
+}
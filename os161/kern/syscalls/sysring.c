@@ -0,0 +1,136 @@
+/*
+ * System call batching. See kern/sysring.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/sysring.h>
+#include <lib.h>
+#include <vm.h>
+#include <thread.h>
+#include <curthread.h>
+#include <syscall.h>
+
+/*
+ * Find the ring in kernel space. It has to be in one piece physically,
+ * which is true of anything within one region of a user address space.
+ * Every page is checked, so a ring that spans a gap between regions is
+ * refused even if the pages on either side happen to line up.
+ */
+static
+int
+sysring_map(struct sysring *uring, struct sysring **ret)
+{
+	vaddr_t start, end, va;
+	paddr_t pstart, pa;
+	int result;
+
+	start = (vaddr_t)uring;
+	end = start + sizeof(struct sysring) - 1;
+
+	if (uring == NULL || start % sizeof(u_int32_t) != 0) {
+		return EFAULT;
+	}
+	if (end < start || end >= USERTOP) {
+		return EFAULT;
+	}
+
+	result = vm_translate(curthread->t_vmspace, start, &pstart);
+	if (result) {
+		return result;
+	}
+	for (va = (start & PAGE_FRAME) + PAGE_SIZE; va <= end; va += PAGE_SIZE) {
+		result = vm_translate(curthread->t_vmspace, va, &pa);
+		if (result) {
+			return result;
+		}
+		if (pa - pstart != va - start) {
+			return EFAULT;
+		}
+	}
+
+	*ret = (struct sysring *)PADDR_TO_KVADDR(pstart);
+	return 0;
+}
+
+/*
+ * Run one request.
+ */
+static
+int
+sysring_do(struct sysring_sqe *sqe, int32_t *retval)
+{
+	*retval = 0;
+
+	switch (sqe->op) {
+	    case SYSRING_OP_NOP:
+		return 0;
+	    case SYSRING_OP_READ:
+		return sys_read(sqe->fd, sqe->buf, sqe->len, retval);
+	    case SYSRING_OP_WRITE:
+		return sys_print(sqe->fd, sqe->buf, sqe->len, retval);
+	    case SYSRING_OP_PREAD:
+		return sys_pread(sqe->fd, sqe->buf, sqe->len, sqe->off, retval);
+	    case SYSRING_OP_PWRITE:
+		return sys_pwrite(sqe->fd, sqe->buf, sqe->len, sqe->off,
+				  retval);
+	    case SYSRING_OP_OPEN:
+		return sys_open(sqe->buf, sqe->flags, retval);
+	    case SYSRING_OP_CLOSE:
+		return sys_close(sqe->fd);
+	}
+	return EINVAL;
+}
+
+/*
+ * Run everything on the submission queue, or as much as there is room
+ * for on the completion queue. Returns the number of requests run.
+ */
+int
+sys_sysring_enter(struct sysring *uring, int32_t *retval)
+{
+	struct sysring *ring;
+	struct sysring_sqe sqe;
+	struct sysring_cqe *cqe;
+	u_int32_t head, tail;
+	int32_t result;
+	int n = 0, err;
+
+	err = sysring_map(uring, &ring);
+	if (err) {
+		*retval = -1;
+		return err;
+	}
+
+	head = ring->sq_head;
+	tail = ring->sq_tail;
+	if (tail - head > SYSRING_ENTRIES) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	while (head != tail) {
+		if (ring->cq_tail - ring->cq_head >= SYSRING_ENTRIES) {
+			/* No room to report the result */
+			break;
+		}
+
+		/* Take a copy so the process can't change it under us */
+		sqe = ring->sq[head & SYSRING_MASK];
+
+		err = sysring_do(&sqe, &result);
+
+		cqe = &ring->cq[ring->cq_tail & SYSRING_MASK];
+		cqe->user_data = sqe.user_data;
+		cqe->result = err ? -1 : result;
+		cqe->error = err;
+		ring->cq_tail++;
+
+		head++;
+		ring->sq_head = head;
+		n++;
+	}
+
+	*retval = n;
+	return 0;
+}
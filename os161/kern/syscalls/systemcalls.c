@@ -14,120 +14,768 @@
 #include <vfs.h>
 #include <addrspace.h>
 #include <kern/unistd.h>
+#include <kern/limits.h>
+#include <kern/stat.h>
+#include <kern/time.h>
+#include <file.h>
+#include <pipe.h>
 #include <vm.h>
 #include <test.h>
+#include <clock.h>
+#include <callout.h>
 
 /*
- * This is the system call that prints to user input  
+ * Do a read or write on file descriptor fd at the file's current offset,
+ * using the buffers described by u. Returns the number of bytes
+ * transferred in retval.
  */
-int sys_print(int fd, userptr_t *buf, size_t nbytes, int32_t *retval){
+static int file_rw(int fd, struct uio *u, int32_t *retval){
 
 	//declare variables and structures
-	struct uio printer;
-	struct vnode *vn;
-	int error;
-	char *console = NULL;
+	struct openfile *of;
+	struct stat st;
+	size_t len = u->uio_resid;
+	int error, how;
+
+	//look up the file descriptor
+	error = filetable_get(curthread->t_filetable, fd, &of);
+	if(error){
+		*retval = -1;
+		return error;
+	}
 
-	//check errors
-	if(!fd){
+	//make sure the file was opened the right way
+	how = of->of_flags & O_ACCMODE;
+	if((u->uio_rw == UIO_READ && how == O_WRONLY) || (u->uio_rw == UIO_WRITE && how == O_RDONLY)){
 		*retval = -1;
 		return EBADF;
 	}
 
-	//open up console
-	console = kstrdup("con:");
-	error = vfs_open(console, 0, &vn);
+	lock_acquire(of->of_lock);
+
+	//appending writes always go at the end of the file
+	if(u->uio_rw == UIO_WRITE && (of->of_flags & O_APPEND)){
+		error = VOP_STAT(of->of_vnode, &st);
+		if(error){
+			lock_release(of->of_lock);
+			*retval = -1;
+			return error;
+		}
+		of->of_offset = st.st_size;
+	}
+
+	//do the transfer at the current offset
+	u->uio_offset = of->of_offset;
+	if(u->uio_rw == UIO_READ){
+		error = VOP_READ(of->of_vnode, u);
+	}
+	else {
+		error = VOP_WRITE(of->of_vnode, u);
+	}
 
 	//check errors
 	switch(error){
 		case 0: 
+		of->of_offset = u->uio_offset;
+		lock_release(of->of_lock);
+		*retval = len - u->uio_resid;
+		return 0;
 		break;
 		
 		default: 
+		lock_release(of->of_lock);
 		*retval = -1;
 		return error;
 		break;
 	}
+}
+
+/*
+ * This is the system call that prints to user input  
+ */
+int sys_print(int fd, userptr_t *buf, size_t nbytes, int32_t *retval){
+
+	struct uio printer;
+
+	if(buf == NULL){
+		*retval = -1;
+		return EFAULT;
+	}
 
 	//create a uio that writes
 	mk_uuio(&printer, buf, nbytes, 0, UIO_WRITE);
 
-	kfree(console);
+	return file_rw(fd, &printer, retval);
+}
 
-	//WRITE to the user console
-	error = VOP_WRITE(vn, &printer);
+/*
+ * This is the system call that reads the user input  
+ */
+int sys_read(int fd, userptr_t *buf, size_t buflen, int32_t *retval){
 
-	//check errors
-	switch(error){
-		case 0: 
-		*retval = nbytes;
-		return 0;
-		break;
-		
-		default: 
+	struct uio reader;
+
+	if(buf == NULL){
 		*retval = -1;
-		return error;
-		break;
+		return EFAULT;
 	}
+
+	//create a uio that reads
+	mk_uuio(&reader, buf, buflen, 0, UIO_READ);
+
+	return file_rw(fd, &reader, retval);
 }
 
 /*
- * This is the system call that reads from user input  
+ * Do a read or write on file descriptor fd at a given offset, leaving
+ * the file's own offset alone. Since the offset isn't touched, the
+ * open file's lock isn't taken either, so several threads can do this
+ * on the same file at once.
  */
-int sys_read(int fd, userptr_t *buf, size_t buflen, int32_t *retval){
+static int file_prw(int fd, userptr_t *buf, size_t len, off_t pos, enum uio_rw rw, int32_t *retval){
 
 	//declare variables and structures
+	struct openfile *of;
+	struct uio u;
+	int error, how;
+
+	//look up the file descriptor
+	error = filetable_get(curthread->t_filetable, fd, &of);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	//make sure the file was opened the right way
+	how = of->of_flags & O_ACCMODE;
+	if((rw == UIO_READ && how == O_WRONLY) || (rw == UIO_WRITE && how == O_RDONLY)){
+		*retval = -1;
+		return EBADF;
+	}
+
+	if(buf == NULL){
+		*retval = -1;
+		return EFAULT;
+	}
+	if(pos < 0){
+		*retval = -1;
+		return EINVAL;
+	}
+
+	//positional I/O only makes sense on things that can seek
+	error = VOP_TRYSEEK(of->of_vnode, pos);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	//do the transfer at the offset we were given
+	mk_uuio(&u, buf, len, pos, rw);
+	if(rw == UIO_READ){
+		error = VOP_READ(of->of_vnode, &u);
+	}
+	else {
+		error = VOP_WRITE(of->of_vnode, &u);
+	}
+
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	*retval = len - u.uio_resid;
+	return 0;
+}
+
+/*
+ * This system call reads from a given offset in a file
+ */
+int sys_pread(int fd, userptr_t *buf, size_t buflen, off_t pos, int32_t *retval){
+
+	return file_prw(fd, buf, buflen, pos, UIO_READ, retval);
+}
+
+/*
+ * This system call writes at a given offset in a file
+ */
+int sys_pwrite(int fd, userptr_t *buf, size_t nbytes, off_t pos, int32_t *retval){
+
+	return file_prw(fd, buf, nbytes, pos, UIO_WRITE, retval);
+}
+
+/*
+ * Copy in an array of iovcnt user iovecs and set up a uio for them.
+ * The user's struct iovec has the same layout as ours: a pointer
+ * followed by a length.
+ */
+static int copyin_iovec(const struct iovec *uiov, int iovcnt, struct iovec *kiov, struct uio *u, enum uio_rw rw){
+
+	//declare variables
+	size_t total = 0;
+	int i, error;
+
+	if(iovcnt <= 0 || iovcnt > IOV_MAX){
+		return EINVAL;
+	}
+
+	error = copyin((const_userptr_t) uiov, kiov, iovcnt * sizeof(struct iovec));
+	if(error){
+		return error;
+	}
+
+	//the total length has to fit in the return value
+	for(i = 0; i < iovcnt; i++){
+		if(kiov[i].iov_len > 0x7fffffff - total){
+			return EINVAL;
+		}
+		total += kiov[i].iov_len;
+	}
+
+	mk_uuiov(u, kiov, iovcnt, 0, rw);
+	return 0;
+}
+
+/*
+ * This system call reads into several buffers in one go
+ */
+int sys_readv(int fd, const struct iovec *iov, int iovcnt, int32_t *retval){
+
+	struct iovec kiov[IOV_MAX];
 	struct uio reader;
-	struct vnode *vn;
 	int error;
-	char *console = NULL;
 
-	//check errors
-	if(fd){
+	error = copyin_iovec(iov, iovcnt, kiov, &reader, UIO_READ);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	return file_rw(fd, &reader, retval);
+}
+
+/*
+ * This system call writes from several buffers in one go
+ */
+int sys_writev(int fd, const struct iovec *iov, int iovcnt, int32_t *retval){
+
+	struct iovec kiov[IOV_MAX];
+	struct uio printer;
+	int error;
+
+	error = copyin_iovec(iov, iovcnt, kiov, &printer, UIO_WRITE);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	return file_rw(fd, &printer, retval);
+}
+
+/*
+ * Bounce buffer for copying between files inside the kernel. One is kept
+ * around for reuse; if it's busy, a copier gets a temporary one.
+ */
+#define COPY_BUFSIZE (4 * PAGE_SIZE)
+static char *copybuf;
+static int copybuf_busy;
+
+static char *copybuf_get(void){
+
+	char *buf = NULL;
+	int spl;
+
+	spl = splhigh();
+	if(copybuf != NULL && !copybuf_busy){
+		copybuf_busy = 1;
+		buf = copybuf;
+	}
+	splx(spl);
+
+	if(buf == NULL){
+		buf = kmalloc(COPY_BUFSIZE);
+	}
+	return buf;
+}
+
+static void copybuf_put(char *buf){
+
+	int spl;
+
+	spl = splhigh();
+	if(buf == copybuf){
+		copybuf_busy = 0;
+		buf = NULL;
+	}
+	else if(copybuf == NULL){
+		//keep it for next time
+		copybuf = buf;
+		buf = NULL;
+	}
+	splx(spl);
+
+	if(buf != NULL){
+		kfree(buf);
+	}
+}
+
+/*
+ * This system call copies up to len bytes from one open file to another,
+ * starting at and advancing each file's offset. The data never goes
+ * through user space. Returns the number of bytes copied, which is 0 at
+ * end of file.
+ */
+int sys_copy_file_range(int infd, int outfd, size_t len, int32_t *retval){
+
+	//declare variables and structures
+	struct openfile *in, *out;
+	struct uio ku;
+	struct stat st;
+	char *buf;
+	size_t chunk, got, put, total = 0;
+	int error;
+
+	//look up both files and check how they were opened
+	error = filetable_get(curthread->t_filetable, infd, &in);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+	error = filetable_get(curthread->t_filetable, outfd, &out);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+	if((in->of_flags & O_ACCMODE) == O_WRONLY || (out->of_flags & O_ACCMODE) == O_RDONLY){
 		*retval = -1;
 		return EBADF;
 	}
+	if(in == out){
+		*retval = -1;
+		return EINVAL;
+	}
+	if(len > 0x7fffffff){
+		len = 0x7fffffff;
+	}
 
+	buf = copybuf_get();
 	if(buf == NULL){
 		*retval = -1;
+		return ENOMEM;
+	}
+
+	//lock the two files in a fixed order so two copies can't deadlock
+	if(in < out){
+		lock_acquire(in->of_lock);
+		lock_acquire(out->of_lock);
+	}
+	else {
+		lock_acquire(out->of_lock);
+		lock_acquire(in->of_lock);
+	}
+
+	while(total < len){
+		chunk = len - total;
+		if(chunk > COPY_BUFSIZE){
+			chunk = COPY_BUFSIZE;
+		}
+
+		//read a chunk into the bounce buffer
+		mk_kuio(&ku, buf, chunk, in->of_offset, UIO_READ);
+		error = VOP_READ(in->of_vnode, &ku);
+		if(error){
+			break;
+		}
+		in->of_offset = ku.uio_offset;
+		got = chunk - ku.uio_resid;
+		if(got == 0){
+			//end of file
+			break;
+		}
+
+		//appending writes always go at the end of the file
+		if(out->of_flags & O_APPEND){
+			error = VOP_STAT(out->of_vnode, &st);
+			if(error){
+				break;
+			}
+			out->of_offset = st.st_size;
+		}
+
+		//and write it out again
+		mk_kuio(&ku, buf, got, out->of_offset, UIO_WRITE);
+		error = VOP_WRITE(out->of_vnode, &ku);
+		if(error){
+			break;
+		}
+		out->of_offset = ku.uio_offset;
+		put = got - ku.uio_resid;
+		total += put;
+		if(put < got){
+			break;
+		}
+	}
+
+	lock_release(in->of_lock);
+	lock_release(out->of_lock);
+	copybuf_put(buf);
+
+	//only report an error if nothing got copied
+	if(error && total == 0){
+		*retval = -1;
+		return error;
+	}
+
+	*retval = total;
+	return 0;
+}
+
+/*
+ * Copy in a path name. The caller frees the result.
+ */
+static int copyin_path(const char *path, char **ret){
+
+	char *kpath;
+	size_t len;
+	int error;
+
+	if(path == NULL){
 		return EFAULT;
 	}
 
-	//open up console
-	console = kstrdup("con:");
-	error = vfs_open(console, 0, &vn);
+	kpath = kmalloc(PATH_MAX);
+	if(kpath == NULL){
+		return ENOMEM;
+	}
+	error = copyinstr((const_userptr_t) path, kpath, PATH_MAX, &len);
+	if(error){
+		kfree(kpath);
+		return error;
+	}
 
-	//check errors
-	switch(error){
-		case 0: 
-		break;
-		
-		default: 
+	*ret = kpath;
+	return 0;
+}
+
+/*
+ * This system call opens a file and returns a file descriptor for it
+ */
+int sys_open(const char *path, int flags, int32_t *retval){
+
+	//declare variables
+	struct openfile *of;
+	char *kpath;
+	int error, fd;
+
+	//copy in the path
+	error = copyin_path(path, &kpath);
+	if(error){
 		*retval = -1;
 		return error;
-		break;
 	}
 
-	//create a uio that reads
-	mk_uuio(&reader, buf, buflen, 0, UIO_READ);
+	//open the file
+	error = openfile_open(kpath, flags, &of);
+	kfree(kpath);
+	if(error){
+		*retval = -1;
+		return error;
+	}
 
-	kfree(console);
+	//give it a file descriptor
+	error = filetable_place(curthread->t_filetable, of, &fd);
+	if(error){
+		openfile_decref(of);
+		*retval = -1;
+		return error;
+	}
 
-	//READ from the user console
-	error = VOP_READ(vn, &reader);
+	*retval = fd;
+	return 0;
+}
 
-	//check errors
-	switch(error){
-		case 0: 
-		*retval = buflen;
-		return 0;
-		break;
-		
-		default: 
+/*
+ * This system call deletes a file
+ */
+int sys_remove(const char *path){
+
+	char *kpath;
+	int error;
+
+	error = copyin_path(path, &kpath);
+	if(error){
+		return error;
+	}
+
+	error = vfs_remove(kpath);
+	kfree(kpath);
+	return error;
+}
+
+/*
+ * This system call renames a file
+ */
+int sys_rename(const char *oldpath, const char *newpath){
+
+	char *kold, *knew;
+	int error;
+
+	error = copyin_path(oldpath, &kold);
+	if(error){
+		return error;
+	}
+	error = copyin_path(newpath, &knew);
+	if(error){
+		kfree(kold);
+		return error;
+	}
+
+	error = vfs_rename(kold, knew);
+	kfree(kold);
+	kfree(knew);
+	return error;
+}
+
+/*
+ * This system call makes a pipe and returns file descriptors for its
+ * read end and write end
+ */
+int sys_pipe(int *fds){
+
+	//declare variables
+	struct vnode *rvn, *wvn;
+	struct openfile *rof, *wof;
+	int kfds[2];
+	int error;
+
+	if(fds == NULL){
+		return EFAULT;
+	}
+
+	error = pipe_create(&rvn, &wvn);
+	if(error){
+		return error;
+	}
+
+	//wrap both ends in open files
+	error = openfile_create(rvn, O_RDONLY, &rof);
+	if(error){
+		vfs_close(rvn);
+		vfs_close(wvn);
+		return error;
+	}
+	error = openfile_create(wvn, O_WRONLY, &wof);
+	if(error){
+		openfile_decref(rof);
+		vfs_close(wvn);
+		return error;
+	}
+
+	//and give them file descriptors
+	error = filetable_place(curthread->t_filetable, rof, &kfds[0]);
+	if(error){
+		openfile_decref(rof);
+		openfile_decref(wof);
+		return error;
+	}
+	error = filetable_place(curthread->t_filetable, wof, &kfds[1]);
+	if(error){
+		filetable_close(curthread->t_filetable, kfds[0]);
+		openfile_decref(wof);
+		return error;
+	}
+
+	error = copyout(kfds, (userptr_t) fds, sizeof(kfds));
+	if(error){
+		filetable_close(curthread->t_filetable, kfds[0]);
+		filetable_close(curthread->t_filetable, kfds[1]);
+		return error;
+	}
+
+	return 0;
+}
+
+/*
+ * This system call closes a file descriptor
+ */
+int sys_close(int fd){
+
+	return filetable_close(curthread->t_filetable, fd);
+}
+
+/*
+ * This system call writes a file's changes out to disk
+ */
+int sys_fsync(int fd){
+
+	struct openfile *of;
+	int error;
+
+	error = filetable_get(curthread->t_filetable, fd, &of);
+	if(error){
+		return error;
+	}
+
+	return VOP_FSYNC(of->of_vnode);
+}
+
+/*
+ * This system call moves the offset of an open file
+ */
+int sys_lseek(int fd, off_t pos, int whence, int32_t *retval){
+
+	//declare variables
+	struct openfile *of;
+	struct stat st;
+	off_t newpos;
+	int error;
+
+	error = filetable_get(curthread->t_filetable, fd, &of);
+	if(error){
 		*retval = -1;
 		return error;
+	}
+
+	lock_acquire(of->of_lock);
+
+	//work out where we are going
+	switch(whence){
+		case SEEK_SET:
+		newpos = pos;
 		break;
+
+		case SEEK_CUR:
+		newpos = of->of_offset + pos;
+		break;
+
+		case SEEK_END:
+		error = VOP_STAT(of->of_vnode, &st);
+		if(error){
+			lock_release(of->of_lock);
+			*retval = -1;
+			return error;
+		}
+		newpos = st.st_size + pos;
+		break;
+
+		default:
+		lock_release(of->of_lock);
+		*retval = -1;
+		return EINVAL;
+		break;
+	}
+
+	if(newpos < 0){
+		lock_release(of->of_lock);
+		*retval = -1;
+		return EINVAL;
 	}
+
+	//make sure the object can be seeked (the console can't)
+	error = VOP_TRYSEEK(of->of_vnode, newpos);
+	if(error){
+		lock_release(of->of_lock);
+		*retval = -1;
+		return error;
+	}
+
+	of->of_offset = newpos;
+	lock_release(of->of_lock);
+
+	*retval = newpos;
+	return 0;
+}
+
+/*
+ * This system call reads the next name out of a directory. The file
+ * offset is used as the position in the directory.
+ */
+int sys_getdirentry(int fd, userptr_t *buf, size_t buflen, int32_t *retval){
+
+	//declare variables
+	struct openfile *of;
+	struct uio u;
+	int error;
+
+	error = filetable_get(curthread->t_filetable, fd, &of);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	lock_acquire(of->of_lock);
+	mk_uuio(&u, buf, buflen, of->of_offset, UIO_READ);
+	error = VOP_GETDIRENTRY(of->of_vnode, &u);
+	if(error){
+		lock_release(of->of_lock);
+		*retval = -1;
+		return error;
+	}
+	of->of_offset = u.uio_offset;
+	lock_release(of->of_lock);
+
+	*retval = buflen - u.uio_resid;
+	return 0;
+}
+
+/*
+ * This system call reads as many directory entries as fit in the
+ * buffer, starting from the position in *cookie, and updates *cookie
+ * so the next call carries on where this one stopped
+ */
+int sys_getdirentries(int fd, userptr_t *buf, size_t buflen, off_t *cookie, int32_t *retval){
+
+	//declare variables
+	struct openfile *of;
+	struct uio u;
+	off_t pos;
+	int error;
+
+	error = filetable_get(curthread->t_filetable, fd, &of);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	error = copyin((const_userptr_t) cookie, &pos, sizeof(pos));
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	//no of_lock: the position belongs to the caller, not the open file
+	mk_uuio(&u, buf, buflen, pos, UIO_READ);
+	error = VOP_GETDIRENTRIES(of->of_vnode, &u);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	pos = u.uio_offset;
+	error = copyout(&pos, (userptr_t) cookie, sizeof(pos));
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	*retval = buflen - u.uio_resid;
+	return 0;
+}
+
+/*
+ * This system call makes newfd refer to the same open file as oldfd
+ */
+int sys_dup2(int oldfd, int newfd, int32_t *retval){
+
+	int error;
+
+	error = filetable_dup2(curthread->t_filetable, oldfd, newfd);
+	if(error){
+		*retval = -1;
+		return error;
+	}
+
+	*retval = newfd;
+	return 0;
 }
 
 /*
@@ -220,7 +868,7 @@ int sys_waitpid(pid_t t_pid, int *status, int options, pid_t *retval){
 	int wait_status, new_ret, error;
 
 	//Check errors
-	if (t_pid <= 0 || t_pid > MAX_PIDS){
+	if (t_pid <= 0 || t_pid > PID_MAX){
 		*retval = -1;
 		return EINVAL;
 	}
@@ -434,6 +1082,93 @@ int sys_execv(const char *program, char **args, int32_t *retval){
 	return EINVAL;
 }
 
+/*
+ * This system call suspends the current thread for the time given in req,
+ * rounded up to the next clock tick
+ */
+int sys_nanosleep(const struct timespec *req, struct timespec *rem){
+
+	//declare variables and structures
+	struct timespec ts;
+	u_int32_t ticks, chunk;
+	int error, s;
+
+	//copy in the requested time
+	error = copyin((const_userptr_t) req, &ts, sizeof(ts));
+	if(error){
+		return error;
+	}
+
+	//check errors
+	if(ts.tv_sec < 0 || ts.tv_nsec >= 1000000000){
+		return EINVAL;
+	}
+	if(ts.tv_sec >= 0x7fffffff / HZ){
+		return EINVAL;
+	}
+
+	//convert to clock ticks, rounding up
+	ticks = ts.tv_sec * HZ + DIVROUNDUP(ts.tv_nsec, 1000000000 / HZ);
+
+	//sleep on our own timespec; nobody else will wake us up. The
+	//callout wheel only reaches CALLOUT_MAXTICKS ahead, so a longer
+	//sleep is done in pieces
+	while(ticks > 0){
+		chunk = ticks > CALLOUT_MAXTICKS ? CALLOUT_MAXTICKS : ticks;
+		s = splhigh();
+		thread_sleep_timeout(&ts, chunk);
+		splx(s);
+		ticks -= chunk;
+	}
+
+	//we can't be interrupted early, so there's never any time left over
+	if(rem != NULL){
+		ts.tv_sec = 0;
+		ts.tv_nsec = 0;
+		error = copyout(&ts, (userptr_t) rem, sizeof(ts));
+		if(error){
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * This system call returns the time of day. Programs normally read the
+ * clock page instead (see kern/clockpage.h); this is for finer
+ * resolution than a clock tick, and for anything that wants a trap
+ */
+int sys___time(time_t *secs, unsigned long *nsecs, int32_t *retval){
+
+	//declare variables
+	time_t ksecs;
+	u_int32_t knsecs;
+	unsigned long unsecs;
+	int error;
+
+	gettime(&ksecs, &knsecs);
+
+	if(secs != NULL){
+		error = copyout(&ksecs, (userptr_t) secs, sizeof(ksecs));
+		if(error){
+			*retval = -1;
+			return error;
+		}
+	}
+	if(nsecs != NULL){
+		unsecs = knsecs;
+		error = copyout(&unsecs, (userptr_t) nsecs, sizeof(unsecs));
+		if(error){
+			*retval = -1;
+			return error;
+		}
+	}
+
+	*retval = ksecs;
+	return 0;
+}
+
 /*
  * This system call moves the end address of the heap region, 
  * then returns the old nd of the heap
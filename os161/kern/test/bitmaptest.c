@@ -10,8 +10,8 @@ bitmaptest(int nargs, char **args)
 {
 	struct bitmap *b;
 	char data[TESTSIZE];
-	u_int32_t x;
-	int i;
+	u_int32_t x, goal, want;
+	int i, j;
 
 	(void)nargs;
 	(void)args;
@@ -72,6 +72,34 @@ bitmaptest(int nargs, char **args)
 		assert(data[i]==0);
 	}
 
+	/*
+	 * Free some bits again, and check that bitmap_alloc_near finds
+	 * the first free one at or after the goal.
+	 */
+	for (i=0; i<TESTSIZE; i++) {
+		if (random()%8 == 0) {
+			bitmap_unmark(b, i);
+			data[i] = 1;
+		}
+	}
+	while (1) {
+		goal = random() % TESTSIZE;
+		want = TESTSIZE;
+		for (j=0; j<TESTSIZE; j++) {
+			if (data[(goal+j) % TESTSIZE]) {
+				want = (goal+j) % TESTSIZE;
+				break;
+			}
+		}
+		if (bitmap_alloc_near(b, goal, &x)) {
+			assert(want == TESTSIZE);
+			break;
+		}
+		assert(x == want);
+		assert(bitmap_isset(b, x));
+		data[x] = 0;
+	}
+
 	kprintf("Bitmap test complete\n");
 	return 0;
 }
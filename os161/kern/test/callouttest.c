@@ -0,0 +1,98 @@
+/*
+ * Timer wheel / callout test code.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <machine/spl.h>
+#include <synch.h>
+#include <thread.h>
+#include <callout.h>
+#include <clock.h>
+#include <test.h>
+
+#define NCALLOUTS 8
+
+/* Delays chosen to land on every level of the wheel. */
+static const u_int32_t delays[NCALLOUTS] = {
+	1, 2, 7, 63, 64, 65, 200, 4100,
+};
+
+static struct callout callouts[NCALLOUTS];
+static volatile u_int32_t firedat[NCALLOUTS];
+static volatile int nfired;
+
+static
+void
+callouttest_fire(void *arg)
+{
+	int i = (int)arg;
+
+	firedat[i] = callout_getticks();
+	nfired++;
+	thread_wakeup((void *)&nfired);
+}
+
+int
+callouttest(int nargs, char **args)
+{
+	struct lock *lk;
+	struct cv *cv;
+	u_int32_t start;
+	int i, s, result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting callout test...\n");
+
+	s = splhigh();
+	nfired = 0;
+	start = callout_getticks();
+	for (i=0; i<NCALLOUTS; i++) {
+		firedat[i] = 0;
+		callout_init(&callouts[i]);
+		callout_reset(&callouts[i], delays[i], callouttest_fire,
+			      (void *)i);
+	}
+
+	/* Stopping and restarting one should move it. */
+	assert(callout_stop(&callouts[1]));
+	assert(!callout_pending(&callouts[1]));
+	callout_reset(&callouts[1], delays[1], callouttest_fire, (void *)1);
+
+	while (nfired < NCALLOUTS) {
+		thread_sleep((void *)&nfired);
+	}
+	splx(s);
+
+	for (i=0; i<NCALLOUTS; i++) {
+		kprintf("callout %d: wanted %u ticks, got %u\n", i,
+			delays[i], firedat[i] - start);
+		assert(firedat[i] - start == delays[i]);
+	}
+
+	/* Nobody is going to wake us, so this must time out. */
+	s = splhigh();
+	result = thread_sleep_timeout(&start, HZ/10);
+	splx(s);
+	assert(result == ETIMEDOUT);
+
+	lk = lock_create("callouttest");
+	cv = cv_create("callouttest");
+	if (lk == NULL || cv == NULL) {
+		panic("callouttest: out of memory\n");
+	}
+	lock_acquire(lk);
+	result = cv_timedwait(cv, lk, HZ/10);
+	assert(result == ETIMEDOUT);
+	assert(lock_do_i_hold(lk));
+	lock_release(lk);
+	cv_destroy(cv);
+	lock_destroy(lk);
+
+	kprintf("Callout test done.\n");
+
+	return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * Timed callouts.
+ *
+ * Pending callouts live in a hierarchical timer wheel. Level 0 has one
+ * slot per tick for the next WHEEL_SIZE ticks; each level above covers
+ * WHEEL_SIZE times as long with slots WHEEL_SIZE times as wide. Every
+ * tick runs the level 0 slot for that tick; when level 0 wraps around,
+ * the next slot of level 1 is redistributed ("cascaded") into level
+ * 0, and so on up. Adding, removing and expiring callouts is O(1).
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <machine/spl.h>
+#include <callout.h>
+
+#define WHEEL_BITS    6
+#define WHEEL_SIZE    (1 << WHEEL_BITS)
+#define WHEEL_MASK    (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS  4
+
+#if CALLOUT_MAXTICKS != (1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1
+#error "CALLOUT_MAXTICKS doesn't match the size of the wheel"
+#endif
+
+static struct callout *wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* Next tick to be processed. */
+static u_int32_t wheel_base;
+
+/* Number of callouts on the wheel. */
+static int wheel_count;
+
+/*
+ * Put a callout on the list for the right slot of the wheel, relative
+ * to wheel_base.
+ */
+static
+void
+wheel_insert(struct callout *c)
+{
+	u_int32_t delta;
+	struct callout **head;
+	int level;
+
+	delta = c->c_expire - wheel_base;
+	if ((int32_t)delta < 0) {
+		/* Already due; run it on the next tick. */
+		c->c_expire = wheel_base;
+		delta = 0;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS-1; level++) {
+		if (delta < (1U << (WHEEL_BITS * (level+1)))) {
+			break;
+		}
+	}
+
+	head = &wheel[level][(c->c_expire >> (WHEEL_BITS*level)) & WHEEL_MASK];
+
+	c->c_next = *head;
+	if (c->c_next != NULL) {
+		c->c_next->c_prevnext = &c->c_next;
+	}
+	c->c_prevnext = head;
+	*head = c;
+}
+
+/*
+ * Take a callout off whatever wheel list it's on.
+ */
+static
+void
+wheel_remove(struct callout *c)
+{
+	*c->c_prevnext = c->c_next;
+	if (c->c_next != NULL) {
+		c->c_next->c_prevnext = c->c_prevnext;
+	}
+	c->c_next = NULL;
+	c->c_prevnext = NULL;
+}
+
+/*
+ * Redistribute the slot of LEVEL that is now current into the levels
+ * below it. Returns the slot index, which is 0 if the level above
+ * needs cascading as well.
+ */
+static
+int
+wheel_cascade(int level)
+{
+	struct callout *c, *list;
+	int slot;
+
+	slot = (wheel_base >> (WHEEL_BITS*level)) & WHEEL_MASK;
+
+	list = wheel[level][slot];
+	wheel[level][slot] = NULL;
+
+	while (list != NULL) {
+		c = list;
+		list = c->c_next;
+		wheel_insert(c);
+	}
+
+	return slot;
+}
+
+void
+callout_init(struct callout *c)
+{
+	c->c_next = NULL;
+	c->c_prevnext = NULL;
+	c->c_expire = 0;
+	c->c_func = NULL;
+	c->c_arg = NULL;
+	c->c_pending = 0;
+}
+
+void
+callout_reset(struct callout *c, u_int32_t ticks,
+	      void (*func)(void *), void *arg)
+{
+	int s;
+
+	assert(func != NULL);
+
+	if (ticks < 1) {
+		ticks = 1;
+	}
+	if (ticks > CALLOUT_MAXTICKS) {
+		ticks = CALLOUT_MAXTICKS;
+	}
+
+	s = splhigh();
+
+	if (c->c_pending) {
+		wheel_remove(c);
+		wheel_count--;
+	}
+
+	/* wheel_base is the next tick, so one tick from now. */
+	c->c_expire = wheel_base + ticks - 1;
+	c->c_func = func;
+	c->c_arg = arg;
+	c->c_pending = 1;
+	wheel_insert(c);
+	wheel_count++;
+
+	splx(s);
+}
+
+int
+callout_stop(struct callout *c)
+{
+	int s, was;
+
+	s = splhigh();
+	was = c->c_pending;
+	if (was) {
+		wheel_remove(c);
+		wheel_count--;
+		c->c_pending = 0;
+	}
+	splx(s);
+
+	return was;
+}
+
+int
+callout_pending(struct callout *c)
+{
+	return c->c_pending;
+}
+
+/*
+ * Process one clock tick. Called from hardclock with interrupts off.
+ */
+void
+callout_tick(void)
+{
+	struct callout *c, *list;
+	int level, slot;
+
+	assert(curspl>0);
+
+	slot = wheel_base & WHEEL_MASK;
+
+	if (wheel_count > 0 && slot == 0) {
+		for (level = 1; level < WHEEL_LEVELS; level++) {
+			if (wheel_cascade(level) != 0) {
+				break;
+			}
+		}
+	}
+
+	/*
+	 * Detach the whole list before running anything, and advance
+	 * the base first, so callouts that reschedule themselves
+	 * don't land back on the list we're working through.
+	 */
+	list = wheel[0][slot];
+	wheel[0][slot] = NULL;
+	if (list != NULL) {
+		list->c_prevnext = &list;
+	}
+	wheel_base++;
+
+	while (list != NULL) {
+		c = list;
+		wheel_remove(c);
+		wheel_count--;
+		c->c_pending = 0;
+		c->c_func(c->c_arg);
+	}
+}
+
+/*
+ * Return how many ticks from now the next callout might be due. This
+ * only looks at level 0; if nothing is there, we report the next
+ * point at which a higher level will be cascaded down. That includes
+ * the very next tick, if it starts a new level 0 cycle: the level 1
+ * slot for that cycle hasn't been cascaded yet, so level 0 looks
+ * empty even though callouts may be due in it.
+ */
+u_int32_t
+callout_nextevent(u_int32_t maxticks)
+{
+	u_int32_t i;
+
+	assert(curspl>0);
+
+	if (wheel_count == 0) {
+		return maxticks;
+	}
+
+	for (i=0; i<maxticks && i<WHEEL_SIZE; i++) {
+		if (((wheel_base + i) & WHEEL_MASK) == 0) {
+			return i+1;
+		}
+		if (wheel[0][(wheel_base + i) & WHEEL_MASK] != NULL) {
+			return i+1;
+		}
+	}
+	return i;
+}
+
+u_int32_t
+callout_getticks(void)
+{
+	return wheel_base;
+}
@@ -2,9 +2,14 @@
 #include <lib.h>
 #include <machine/spl.h>
 #include <thread.h>
+#include <curthread.h>
+#include <scheduler.h>
 #include <clock.h>
+#include <callout.h>
+#include <vm.h>
+#include <kern/clockpage.h>
 
-/* 
+/*
  * The address of lbolt has thread_wakeup called on it once a second.
  */
 int lbolt;
@@ -12,26 +17,347 @@ int lbolt;
 static int lbolt_counter;
 
 /*
- * This is called HZ times a second by the timer device setup.
+ * Timer device used for hardclock, if it can be reprogrammed. This is
+ * registered by the timer driver (see ltimer.c) and lets us stop
+ * taking a tick every 1/HZ seconds while the cpu is idle.
  */
+static void *hc_devdata;
+static void (*hc_settimer)(void *devdata, u_int32_t usecs);
+static void (*hc_gettime)(void *devdata, time_t *secs, u_int32_t *nsecs);
+
+/* Nonzero while the scheduler is idling with the timer stretched out */
+static int hc_idle;
+
+/* Number of ticks the timer is currently programmed for */
+static u_int32_t hc_period = 1;
+
+/* Time up to which ticks have been accounted for while idle */
+static time_t hc_idlesecs;
+static u_int32_t hc_idlensecs;
+
+/* Quantum accounting */
+static struct thread *hc_lastthread;
+static int hc_quantum;
 
+/* Statistics */
+static u_int32_t hc_ticks;		/* clock ticks accounted for */
+static u_int32_t hc_interrupts;		/* timer interrupts taken */
+static u_int32_t hc_switches;		/* switches done by hardclock */
+static u_int32_t hc_noswitch;		/* yields skipped, nothing to run */
+static u_int32_t hc_inquantum;		/* yields skipped, quantum left */
+
+#define NSECS_PER_TICK  (1000000000/HZ)
+#define USECS_PER_TICK  (1000000/HZ)
+
+/*
+ * The clock page mapped read-only into user address spaces (see
+ * kern/clockpage.h). It is rewritten on every tick we account for.
+ */
+static struct clockpage *hc_clockpage;
+static paddr_t hc_clockpaddr;
+
+/*
+ * Set up the clock page. Called once VM is up.
+ */
 void
-hardclock(void)
+clockpage_bootstrap(void)
 {
-	/*
-	 * Collect statistics here as desired.
-	 */
+	vaddr_t page;
+	int s;
+
+	page = alloc_kpages(1);
+	if (page == 0) {
+		panic("clockpage: Out of memory\n");
+	}
+	bzero((void *)page, PAGE_SIZE);
+
+	s = splhigh();
+	hc_clockpage = (struct clockpage *)page;
+	hc_clockpaddr = page - MIPS_KSEG0;
+	hc_clockpage->cp_hz = HZ;
+	hc_clockpage->cp_ticks = hc_ticks;
+	gettime((time_t *)&hc_clockpage->cp_secs,
+		(u_int32_t *)&hc_clockpage->cp_nsecs);
+	splx(s);
+}
+
+/*
+ * Physical address of the clock page, for vm_fault. 0 before
+ * clockpage_bootstrap.
+ */
+paddr_t
+clockpage_paddr(void)
+{
+	return hc_clockpaddr;
+}
+
+/*
+ * Refresh the clock page. Interrupts are off, so nothing else in the
+ * kernel can be writing it; the sequence counter is for user readers.
+ */
+static
+void
+clockpage_update(void)
+{
+	struct clockpage *cp = hc_clockpage;
+	time_t secs;
+	u_int32_t nsecs;
+
+	if (cp == NULL) {
+		return;
+	}
 
+	gettime(&secs, &nsecs);
 
-	lbolt_counter++;
+	cp->cp_seq++;
+	cp->cp_secs = secs;
+	cp->cp_nsecs = nsecs;
+	cp->cp_ticks = hc_ticks;
+	cp->cp_seq++;
+}
+
+/*
+ * Called by the timer driver that is responsible for hardclock, if it
+ * knows how to change its interrupt interval. SETTIMER should arm the
+ * timer to go off every USECS microseconds; GETTIME should read the
+ * current time.
+ */
+void
+hardclock_register(void *devdata,
+		   void (*settimer)(void *devdata, u_int32_t usecs),
+		   void (*gettimefn)(void *devdata,
+				     time_t *secs, u_int32_t *nsecs))
+{
+	int s = splhigh();
+
+	hc_devdata = devdata;
+	hc_settimer = settimer;
+	hc_gettime = gettimefn;
+	hc_period = 1;
+
+	splx(s);
+}
+
+/*
+ * Handle NTICKS ticks worth of timed events.
+ */
+static
+void
+hardclock_advance(u_int32_t nticks)
+{
+	u_int32_t i;
+
+	hc_ticks += nticks;
+
+	lbolt_counter += nticks;
 	if (lbolt_counter >= HZ) {
-		lbolt_counter = 0;
+		lbolt_counter %= HZ;
 		thread_wakeup(&lbolt);
 	}
 
+	for (i=0; i<nticks; i++) {
+		callout_tick();
+	}
+
+	clockpage_update();
+}
+
+/*
+ * Number of ticks until something is next due to happen.
+ */
+static
+u_int32_t
+hardclock_nextevent(void)
+{
+	return callout_nextevent(HZ - lbolt_counter);
+}
+
+/*
+ * Program the hardclock timer to interrupt every NTICKS ticks.
+ */
+static
+void
+hardclock_setperiod(u_int32_t nticks)
+{
+	if (nticks == hc_period) {
+		return;
+	}
+	hc_period = nticks;
+	hc_settimer(hc_devdata, nticks * USECS_PER_TICK);
+}
+
+/*
+ * While idle, work out from the clock how many whole ticks have gone
+ * by since we last looked, and account for them. The fractional part
+ * is carried over to the next call.
+ */
+static
+void
+hardclock_catchup(void)
+{
+	time_t secs;
+	u_int32_t nsecs, elapsed, nticks;
+
+	hc_gettime(hc_devdata, &secs, &nsecs);
+	if (nsecs < hc_idlensecs) {
+		nsecs += 1000000000;
+		secs--;
+	}
+	if (secs - hc_idlesecs >= 4) {
+		/*
+		 * Can't happen unless the timer is broken; avoid
+		 * overflow and start counting again from now.
+		 */
+		hc_gettime(hc_devdata, &hc_idlesecs, &hc_idlensecs);
+		hardclock_advance(hc_period);
+		return;
+	}
+
+	elapsed = (secs - hc_idlesecs) * 1000000000 + (nsecs - hc_idlensecs);
+	nticks = elapsed / NSECS_PER_TICK;
+	if (nticks == 0) {
+		return;
+	}
+
+	hc_idlensecs += (nticks % HZ) * NSECS_PER_TICK;
+	hc_idlesecs += nticks / HZ;
+	if (hc_idlensecs >= 1000000000) {
+		hc_idlensecs -= 1000000000;
+		hc_idlesecs++;
+	}
+
+	hardclock_advance(nticks);
+}
+
+/*
+ * Called by the scheduler, with interrupts off, when there is nothing
+ * to run. Instead of taking a timer interrupt every tick while we sit
+ * in cpu_idle(), reprogram the timer for the next pending event.
+ */
+void
+hardclock_idle_enter(void)
+{
+	assert(curspl>0);
+
+	if (hc_settimer == NULL || hc_idle) {
+		return;
+	}
+
+	hc_idle = 1;
+	hc_gettime(hc_devdata, &hc_idlesecs, &hc_idlensecs);
+	hardclock_setperiod(hardclock_nextevent());
+}
+
+/*
+ * Called by the scheduler, with interrupts off, once something is
+ * runnable again. Account for the ticks we skipped and go back to
+ * ticking every 1/HZ seconds.
+ */
+void
+hardclock_idle_exit(void)
+{
+	assert(curspl>0);
+
+	if (!hc_idle) {
+		return;
+	}
+
+	hardclock_catchup();
+	hc_idle = 0;
+	hardclock_setperiod(1);
+}
+
+/*
+ * This is called HZ times a second by the timer device setup, or less
+ * often if the timer has been stretched out while idle.
+ */
+
+void
+hardclock(void)
+{
+	hc_interrupts++;
+
+	if (hc_idle) {
+		/*
+		 * Idle; account for however many ticks went by and
+		 * rearm for the next event. There's no thread to
+		 * switch away from.
+		 */
+		hardclock_catchup();
+		hardclock_setperiod(hardclock_nextevent());
+		return;
+	}
+
+	hardclock_advance(1);
+
+	if (curthread == NULL) {
+		/* In the scheduler; nothing to preempt. */
+		return;
+	}
+
+	/*
+	 * Only switch if somebody else can run and the current
+	 * thread has used up its quantum. Otherwise the switch would
+	 * just come straight back here.
+	 */
+	if (curthread != hc_lastthread) {
+		hc_lastthread = curthread;
+		hc_quantum = 0;
+	}
+	hc_quantum++;
+
+	if (!scheduler_hasrunnable()) {
+		hc_noswitch++;
+		return;
+	}
+	if (hc_quantum < QUANTUM) {
+		hc_inquantum++;
+		return;
+	}
+
+	hc_quantum = 0;
+	hc_lastthread = NULL;
+	hc_switches++;
 	thread_yield();
 }
 
+/*
+ * Print hardclock statistics, including how many context switches
+ * per second were avoided compared to switching on every tick.
+ */
+void
+hardclock_printstats(void)
+{
+	u_int32_t ticks, interrupts, switches, noswitch, inquantum;
+	u_int32_t secs, saved;
+	int s;
+
+	s = splhigh();
+	ticks = hc_ticks;
+	interrupts = hc_interrupts;
+	switches = hc_switches;
+	noswitch = hc_noswitch;
+	inquantum = hc_inquantum;
+	splx(s);
+
+	secs = ticks / HZ;
+	saved = (ticks - switches);
+
+	kprintf("hardclock: %u ticks (%u.%02u seconds), %u interrupts\n",
+		ticks, secs, (ticks % HZ) * 100 / HZ, interrupts);
+	kprintf("hardclock: %u switches, %u skipped (nothing runnable), "
+		"%u skipped (quantum %d)\n",
+		switches, noswitch, inquantum, QUANTUM);
+	if (ticks > interrupts) {
+		kprintf("hardclock: %u ticks not taken while idle\n",
+			ticks - interrupts);
+	}
+	if (secs > 0) {
+		kprintf("hardclock: %u context switches saved per second\n",
+			saved / secs);
+	}
+}
+
 /*
  * Suspend execution for n seconds.
  */
@@ -40,10 +366,11 @@ clocksleep(int num_secs)
 {
 	int s;
 
-	s = splhigh();
-	while (num_secs > 0) {
-		thread_sleep(&lbolt);
-		num_secs--;
+	if (num_secs <= 0) {
+		return;
 	}
+
+	s = splhigh();
+	thread_sleep_timeout(&num_secs, num_secs * HZ);
 	splx(s);
 }
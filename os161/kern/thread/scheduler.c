@@ -11,6 +11,7 @@
 #include <thread.h>
 #include <machine/spl.h>
 #include <queue.h>
+#include <clock.h>
 
 /*
  *  Scheduler data
@@ -90,8 +91,13 @@ scheduler(void)
 	// meant to be called with interrupts off
 	assert(curspl>0);
 	
-	while (q_empty(runqueue)) {
-		cpu_idle();
+	if (q_empty(runqueue)) {
+		/* Don't take clock ticks we don't need while idle. */
+		hardclock_idle_enter();
+		while (q_empty(runqueue)) {
+			cpu_idle();
+		}
+		hardclock_idle_exit();
 	}
 
 	// You can actually uncomment this to see what the scheduler's
@@ -117,6 +123,18 @@ make_runnable(struct thread *t)
 	return q_addtail(runqueue, t);
 }
 
+/*
+ * Check if there's anything else to run. Used by hardclock to avoid
+ * pointless context switches.
+ */
+int
+scheduler_hasrunnable(void)
+{
+	assert(curspl>0);
+
+	return !q_empty(runqueue);
+}
+
 /*
  * Debugging function to dump the run queue.
  */
@@ -227,6 +227,25 @@ cv_wait(struct cv *cv, struct lock *lock)
 	splx(spl);		// Enable interrupts
 }
 
+int
+cv_timedwait(struct cv *cv, struct lock *lock, u_int32_t ticks)
+{
+	int spl, result;
+	spl = splhigh();		// Disable interrupts
+
+	assert(cv != NULL);		// Make sure the cv isn't NULL
+	assert(lock != NULL);		// Make sure the lock isn't NULL
+	assert(in_interrupt == 0);	// Make sure we aren't in an interrupt handler
+
+	lock_release(lock);		// Release the lock held by the thread
+	result = thread_sleep_timeout(cv, ticks);	// Sleep on the cv until signalled or out of time
+	lock_acquire(lock);		// After waking up, reaquire the lock
+
+	splx(spl);		// Enable interrupts
+
+	return result;
+}
+
 void
 cv_signal(struct cv *cv, struct lock *lock)
 {
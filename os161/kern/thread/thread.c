@@ -12,7 +12,10 @@
 #include <scheduler.h>
 #include <addrspace.h>
 #include <vnode.h>
+#include <file.h>
 #include <synch.h>
+#include <callout.h>
+#include <vm.h>
 #include "opt-synchprobs.h"
 
 
@@ -27,8 +30,13 @@ typedef enum {
 /* Global variable for the thread currently executing at any given time. */
 struct thread *curthread;
 
-/* Table of sleeping threads. */
-static struct array *sleepers;
+/*
+ * List of sleeping threads, oldest first. It's linked through the
+ * threads themselves, so a thread can be taken off it in O(1) (when a
+ * timed sleep expires) and adding one can't fail.
+ */
+static struct thread *sleepers;
+static struct thread **sleepers_tail;
 
 /* List of dead threads to be disposed of. */
 static struct array *zombies;
@@ -36,8 +44,30 @@ static struct array *zombies;
 /* Total number of outstanding threads. Does not count zombies[]. */
 static int numthreads;
 
-/* The structure containing the pid's */
-static struct process *pid[MAX_PIDS];  
+/*
+ * Cache of dead threads, complete with stacks, ready to be handed out
+ * again by thread_fork. Bounded so a burst of forks doesn't pin down
+ * memory forever; thread_cache_shrink empties it under memory pressure.
+ */
+#define THREAD_CACHE_MAX 16
+static struct thread *threadcache[THREAD_CACHE_MAX];
+static int threadcache_count;
+static u_int32_t threadcache_hits, threadcache_misses;
+
+/*
+ * Unused stack space is filled with this, so we can tell how deep
+ * stacks have ever gone. The deepest seen is kept in stack_highwater.
+ */
+#define STACK_FILL 0x5a5a5a5a
+static size_t stack_highwater;
+
+/* The table of processes, indexed by pid. Grows as needed. */
+static struct process **pid;
+static int pid_tablesize;
+
+/* Number of pids in use, and where to start looking for a free one */
+static int pid_count;
+static int pid_next;
 
 /* The structure containing the pid's */
 static struct lock *pid_lock;  
@@ -51,37 +81,135 @@ static
 struct thread *
 thread_create(const char *name)
 {
-	struct thread *thread = kmalloc(sizeof(struct thread));
+	struct thread *thread;
+	int s;
+
+	/* Use a cached one if we can. */
+	s = splhigh();
+	if (threadcache_count > 0) {
+		thread = threadcache[--threadcache_count];
+		threadcache_hits++;
+	}
+	else {
+		thread = NULL;
+		threadcache_misses++;
+	}
+	splx(s);
+
 	if (thread==NULL) {
-		return NULL;
+		thread = kmalloc(sizeof(struct thread));
+		if (thread==NULL) {
+			return NULL;
+		}
+		thread->t_stack = NULL;
 	}
-	thread->t_name = kstrdup(name);
-	if (thread->t_name==NULL) {
-		kfree(thread);
-		return NULL;
+
+	if (strlen(name) < THREAD_NAMELEN) {
+		strcpy(thread->t_namebuf, name);
+		thread->t_name = thread->t_namebuf;
+	}
+	else {
+		thread->t_name = kstrdup(name);
+		if (thread->t_name==NULL) {
+			kfree(thread->t_stack);
+			kfree(thread);
+			return NULL;
+		}
 	}
 	thread->t_sleepaddr = NULL;
-	thread->t_stack = NULL;
+	thread->t_sleepnext = NULL;
+	thread->t_sleepprev = NULL;
+	thread->t_timedout = 0;
 	
 	thread->t_vmspace = NULL;
 
 	thread->t_cwd = NULL;
 
+	thread->t_filetable = NULL;
+
 	thread->myPid = 0;
 
 	return thread;
 }
 
+/*
+ * Allocate a stack, filled with STACK_FILL so we can measure how much
+ * of it gets used. Stacks are whole pages, so they come back
+ * page-aligned.
+ */
+static
+char *
+stack_create(void)
+{
+	u_int32_t *words;
+	unsigned i;
+	char *stack;
+
+	stack = kmalloc(STACK_SIZE);
+	if (stack==NULL) {
+		return NULL;
+	}
+	assert(((vaddr_t)stack % PAGE_SIZE)==0);
+
+	words = (u_int32_t *)stack;
+	for (i=0; i<STACK_SIZE/sizeof(u_int32_t); i++) {
+		words[i] = STACK_FILL;
+	}
+
+	return stack;
+}
+
+/*
+ * See how deep a stack went by finding the lowest word that no longer
+ * holds STACK_FILL, update the high-water mark, and refill what was
+ * used so the stack can be measured again next time around.
+ */
+static
+void
+stack_recycle(char *stack)
+{
+	u_int32_t *words = (u_int32_t *)stack;
+	unsigned i, n, first;
+	size_t used;
+
+	n = STACK_SIZE/sizeof(u_int32_t);
+
+	/* word 0 is the magic number */
+	for (first=1; first<n; first++) {
+		if (words[first] != STACK_FILL) {
+			break;
+		}
+	}
+
+	used = (n - first) * sizeof(u_int32_t);
+	if (used > stack_highwater) {
+		stack_highwater = used;
+		if (used > STACK_SIZE - STACK_SIZE/4) {
+			kprintf("thread: warning: stack high-water mark now "
+				"%u of %u bytes\n", used, STACK_SIZE);
+		}
+	}
+
+	for (i=first; i<n; i++) {
+		words[i] = STACK_FILL;
+	}
+}
+
 /*
  * Destroy a thread.
  *
  * This function cannot be called in the victim thread's own context.
  * Freeing the stack you're actually using to run would be... inadvisable.
+ *
+ * If there's room, the thread structure and its stack are kept in the
+ * thread cache for thread_create to reuse instead of being freed.
  */
 static
 void
 thread_destroy(struct thread *thread)
 {
+	int s;
+
 	assert(thread != curthread);
 
 	// If you add things to the thread structure, be sure to dispose of
@@ -90,15 +218,68 @@ thread_destroy(struct thread *thread)
 	// These things are cleaned up in thread_exit.
 	assert(thread->t_vmspace==NULL);
 	assert(thread->t_cwd==NULL);
+	assert(thread->t_filetable==NULL);
 	
+	if (thread->t_name != thread->t_namebuf) {
+		kfree(thread->t_name);
+	}
+	thread->t_name = NULL;
+
 	if (thread->t_stack) {
+		stack_recycle(thread->t_stack);
+
+		s = splhigh();
+		if (threadcache_count < THREAD_CACHE_MAX) {
+			threadcache[threadcache_count++] = thread;
+			splx(s);
+			return;
+		}
+		splx(s);
+
 		kfree(thread->t_stack);
 	}
 
-	kfree(thread->t_name);
 	kfree(thread);
 }
 
+/*
+ * Give back the memory held by the thread cache.
+ */
+int
+thread_cache_shrink(void)
+{
+	struct thread *t;
+	int s, n = 0;
+
+	s = splhigh();
+	while (threadcache_count > 0) {
+		t = threadcache[--threadcache_count];
+		kfree(t->t_stack);
+		kfree(t);
+		n++;
+	}
+	splx(s);
+
+	return n;
+}
+
+/*
+ * Print thread cache and stack usage statistics.
+ */
+void
+thread_printstats(void)
+{
+	int s = splhigh();
+
+	kprintf("thread cache: %d of %d cached, %u hits, %u misses\n",
+		threadcache_count, THREAD_CACHE_MAX,
+		threadcache_hits, threadcache_misses);
+	kprintf("thread stacks: high-water mark %u of %u bytes\n",
+		stack_highwater, STACK_SIZE);
+
+	splx(s);
+}
+
 
 /*
  * Remove zombies. (Zombies are threads/processes that have exited but not
@@ -122,6 +303,37 @@ exorcise(void)
 	assert(result==0);
 }
 
+/*
+ * Put a thread at the end of the sleepers list.
+ */
+static
+void
+sleepers_add(struct thread *t)
+{
+	t->t_sleepnext = NULL;
+	t->t_sleepprev = sleepers_tail;
+	*sleepers_tail = t;
+	sleepers_tail = &t->t_sleepnext;
+}
+
+/*
+ * Take a thread off the sleepers list.
+ */
+static
+void
+sleepers_remove(struct thread *t)
+{
+	*t->t_sleepprev = t->t_sleepnext;
+	if (t->t_sleepnext != NULL) {
+		t->t_sleepnext->t_sleepprev = t->t_sleepprev;
+	}
+	else {
+		sleepers_tail = t->t_sleepprev;
+	}
+	t->t_sleepnext = NULL;
+	t->t_sleepprev = NULL;
+}
+
 /*
  * Kill all sleeping threads. This is used during panic shutdown to make 
  * sure they don't wake up again and interfere with the panic.
@@ -130,7 +342,7 @@ static
 void
 thread_killall(void)
 {
-	int i, result;
+	struct thread *t;
 
 	assert(curspl>0);
 
@@ -139,8 +351,7 @@ thread_killall(void)
 	 * wake up while we're shutting down.
 	 */
 
-	for (i=0; i<array_getnum(sleepers); i++) {
-		struct thread *t = array_getguy(sleepers, i);
+	for (t = sleepers; t != NULL; t = t->t_sleepnext) {
 		kprintf("sleep: Dropping thread %s\n", t->t_name);
 
 		/*
@@ -153,9 +364,8 @@ thread_killall(void)
 		 */
 	}
 
-	result = array_setsize(sleepers, 0);
-	/* shrinking array: not supposed to fail */
-	assert(result==0);
+	sleepers = NULL;
+	sleepers_tail = &sleepers;
 }
 
 /*
@@ -179,10 +389,8 @@ thread_bootstrap(void)
 	struct thread *me;
 
 	/* Create the data structures we need. */
-	sleepers = array_create();
-	if (sleepers==NULL) {
-		panic("Cannot create sleepers array\n");
-	}
+	sleepers = NULL;
+	sleepers_tail = &sleepers;
 
 	zombies = array_create();
 	if (zombies==NULL) {
@@ -222,8 +430,7 @@ thread_bootstrap(void)
 void
 thread_shutdown(void)
 {
-	array_destroy(sleepers);
-	sleepers = NULL;
+	thread_cache_shrink();
 	array_destroy(zombies);
 	zombies = NULL;
 	// Don't do this - it frees our stack and we blow up
@@ -250,12 +457,13 @@ thread_fork(const char *name,
 		return ENOMEM;
 	}
 
-	/* Allocate a stack */
-	newguy->t_stack = kmalloc(STACK_SIZE);
+	/* Allocate a stack, unless we got a cached thread that has one */
 	if (newguy->t_stack==NULL) {
-		kfree(newguy->t_name);
-		kfree(newguy);
-		return ENOMEM;
+		newguy->t_stack = stack_create();
+		if (newguy->t_stack==NULL) {
+			thread_destroy(newguy);
+			return ENOMEM;
+		}
 	}
 
 	/* stick a magic number on the bottom end of the stack */
@@ -264,6 +472,15 @@ thread_fork(const char *name,
 	newguy->t_stack[2] = 0xda;
 	newguy->t_stack[3] = 0x33;
 
+	/* Inherit open files */
+	if (curthread->t_filetable != NULL) {
+		newguy->t_filetable = filetable_copy(curthread->t_filetable);
+		if (newguy->t_filetable == NULL) {
+			thread_destroy(newguy);
+			return ENOMEM;
+		}
+	}
+
 	/* Inherit the current directory */
 	if (curthread->t_cwd != NULL) {
 		VOP_INCREF(curthread->t_cwd);
@@ -280,10 +497,6 @@ thread_fork(const char *name,
 	 * Make sure our data structures have enough space, so we won't
 	 * run out later at an inconvenient time.
 	 */
-	result = array_preallocate(sleepers, numthreads+1);
-	if (result) {
-		goto fail;
-	}
 	result = array_preallocate(zombies, numthreads+1);
 	if (result) {
 		goto fail;
@@ -295,17 +508,20 @@ thread_fork(const char *name,
 		goto fail;
 	}
 
+	//allocate a new pid for the child thread
+	lock_acquire(pid_lock);
+	result = pid_insert(curthread->myPid, &newguy->myPid);
+	lock_release(pid_lock);
+	if (result) {
+		goto fail;
+	}
+
 	/* Make the new thread runnable */
 	result = make_runnable(newguy);
 	if (result != 0) {
 		goto fail;
 	}
 
-	//allocate a new pid for the child thread
-	lock_acquire(pid_lock);
-	newguy->myPid = pid_insert(curthread->myPid, &result);
-	lock_release(pid_lock);
-
 	/*
 	 * Increment the thread counter. This must be done atomically
 	 * with the preallocate calls; otherwise the count can be
@@ -331,12 +547,20 @@ thread_fork(const char *name,
 
  fail:
 	splx(s);
+	if (newguy->t_filetable != NULL) {
+		filetable_destroy(newguy->t_filetable);
+		newguy->t_filetable = NULL;
+	}
+	if (newguy->myPid > 0) {
+		lock_acquire(pid_lock);
+		pid_dealloc(newguy->myPid);
+		lock_release(pid_lock);
+	}
 	if (newguy->t_cwd != NULL) {
 		VOP_DECREF(newguy->t_cwd);
+		newguy->t_cwd = NULL;
 	}
-	kfree(newguy->t_stack);
-	kfree(newguy->t_name);
-	kfree(newguy);
+	thread_destroy(newguy);
 
 	return result;
 }
@@ -388,11 +612,8 @@ mi_switch(threadstate_t nextstate)
 		result = make_runnable(cur);
 	}
 	else if (nextstate==S_SLEEP) {
-		/*
-		 * Because we preallocate sleepers[] during thread_fork,
-		 * this should never fail.
-		 */
-		result = array_add(sleepers, cur);
+		sleepers_add(cur);
+		result = 0;
 	}
 	else {
 		assert(nextstate==S_ZOMB);
@@ -454,6 +675,17 @@ thread_exit(void)
 		assert(curthread->t_stack[3] == (char)0x33);
 	}
 
+	/* Close our files; this may sleep, so do it before splhigh */
+	if (curthread->t_filetable) {
+		filetable_destroy(curthread->t_filetable);
+		curthread->t_filetable = NULL;
+	}
+
+	/* Give up our pid, if we haven't already done so in _exit */
+	if (pid_lock != NULL) {
+		pid_exit(0);
+	}
+
 	splhigh();
 
 	if (curthread->t_vmspace) {
@@ -486,8 +718,8 @@ thread_yield(void)
 {
 	int spl = splhigh();
 
-	/* Check sleepers just in case we get here after shutdown */
-	assert(sleepers != NULL);
+	/* Check zombies just in case we get here after shutdown */
+	assert(zombies != NULL);
 
 	mi_switch(S_READY);
 	splx(spl);
@@ -515,6 +747,62 @@ thread_sleep(const void *addr)
 	curthread->t_sleepaddr = NULL;
 }
 
+/*
+ * Callout function for thread_sleep_timeout. Runs from hardclock with
+ * interrupts off. If the thread is still asleep, wake it up and tell
+ * it it timed out.
+ */
+static
+void
+thread_timeout(void *vt)
+{
+	struct thread *t = vt;
+	int result;
+
+	if (t->t_sleepprev == NULL) {
+		/* Already woken up */
+		return;
+	}
+
+	sleepers_remove(t);
+	t->t_timedout = 1;
+
+	/*
+	 * Because we preallocate during thread_fork,
+	 * this should never fail.
+	 */
+	result = make_runnable(t);
+	assert(result==0);
+}
+
+/*
+ * Sleep on ADDR as thread_sleep does, but for at most TICKS clock
+ * ticks.
+ */
+int
+thread_sleep_timeout(const void *addr, u_int32_t ticks)
+{
+	struct callout timeout;
+
+	// may not sleep in an interrupt handler
+	assert(in_interrupt==0);
+	assert(curspl>0);
+
+	callout_init(&timeout);
+	curthread->t_timedout = 0;
+	callout_reset(&timeout, ticks, thread_timeout, curthread);
+
+	thread_sleep(addr);
+
+	callout_stop(&timeout);
+
+	if (curthread->t_timedout) {
+		curthread->t_timedout = 0;
+		return ETIMEDOUT;
+	}
+	return 0;
+}
+
 /*
  * Wake up one or more threads who are sleeping on "sleep address"
  * ADDR.
@@ -522,22 +810,20 @@ thread_sleep(const void *addr)
 void
 thread_wakeup(const void *addr)
 {
-	int i, result;
+	struct thread *t, *next;
+	int result;
 	
 	// meant to be called with interrupts off
 	assert(curspl>0);
 	
 	// This is inefficient. Feel free to improve it.
 	
-	for (i=0; i<array_getnum(sleepers); i++) {
-		struct thread *t = array_getguy(sleepers, i);
+	for (t = sleepers; t != NULL; t = next) {
+		next = t->t_sleepnext;
 		if (t->t_sleepaddr == addr) {
 			
 			// Remove from list
-			array_remove(sleepers, i);
-			
-			// must look at the same sleepers[i] again
-			i--;
+			sleepers_remove(t);
 
 			/*
 			 * Because we preallocate during thread_fork,
@@ -563,13 +849,11 @@ thread_single_wakeup(const void *addr)
 	assert(curspl>0);
 	
 	// This is inefficient. Feel free to improve it.
-	struct thread *t = array_getguy(sleepers, 0);
-	if (t->t_sleepaddr == addr) {
+	struct thread *t = sleepers;
+	if (t != NULL && t->t_sleepaddr == addr) {
 		
 		// Remove from list
-		array_remove(sleepers, 0);
-		
-		// must look at the same sleepers[i] again
+		sleepers_remove(t);
 
 		/*
 		 * Because we preallocate during thread_fork,
@@ -587,13 +871,12 @@ thread_single_wakeup(const void *addr)
 int
 thread_hassleepers(const void *addr)
 {
-	int i;
+	struct thread *t;
 	
 	// meant to be called with interrupts off
 	assert(curspl>0);
 	
-	for (i=0; i<array_getnum(sleepers); i++) {
-		struct thread *t = array_getguy(sleepers, i);
+	for (t = sleepers; t != NULL; t = t->t_sleepnext) {
 		if (t->t_sleepaddr == addr) {
 			return 1;
 		}
@@ -636,13 +919,70 @@ mi_threadstart(void *data1, unsigned long data2,
 	thread_exit();
 }
 
+/*
+ * Grow the pid table so it has room for at least NEWSIZE entries.
+ * Must hold pid_lock.
+ */
+static int pid_grow(int newsize){
+
+	//declare variables
+	struct process **newtable;
+	int i;
+
+	if(newsize > PID_MAX + 1){
+		newsize = PID_MAX + 1;
+	}
+	if(newsize <= pid_tablesize){
+		return EAGAIN;
+	}
+
+	//allocate the new table and copy the old one into it
+	newtable = kmalloc(newsize * sizeof(struct process *));
+	if(newtable == NULL){
+		return ENOMEM;
+	}
+	for(i = 0; i < pid_tablesize; i++){
+		newtable[i] = pid[i];
+	}
+	for(; i < newsize; i++){
+		newtable[i] = NULL;
+	}
+
+	kfree(pid);
+	pid = newtable;
+	pid_tablesize = newsize;
+
+	return 0;
+}
+
+/*
+ * Look up a pid in the table. Must hold pid_lock.
+ */
+static struct process *pid_get(pid_t t_pid){
+
+	if(t_pid < 0 || t_pid >= pid_tablesize){
+		return NULL;
+	}
+	return pid[t_pid];
+}
+
 /*
  * This function is used to allocate the main OS thread and create the pid lock  
  */
 void pid_bootstrap(void){
 	
+	//create the pid table
+	pid = NULL;
+	pid_tablesize = 0;
+	pid_count = 0;
+	if (pid_grow(PID_INITIAL)) {
+		panic("pid: could not allocate pid table\n");
+	}
+
 	//allocate the first pid for the main OS thread
-	pid[0] = pid_alloc(0, NULL);
+	pid[0] = pid_alloc(0, 0);
+	pid_count = 1;
+	pid_next = 1;
 
 	//set the lock to NULL
 	pid_lock = NULL;
@@ -666,6 +1006,9 @@ struct process *pid_alloc(pid_t pid, pid_t p_pid){
 
 	//Allocate space for the process
 	newpid = kmalloc(sizeof(struct process));
+	if (newpid == NULL) {
+		return NULL;
+	}
 	
 	//set the values of the process using pid and p_pid
 	newpid->thread_pid = pid;
@@ -674,12 +1017,16 @@ struct process *pid_alloc(pid_t pid, pid_t p_pid){
 	newpid->exited = 0;
 	newpid->has_waiters = 0;
 	newpid->exit_semaphore = NULL;
+	newpid->children = NULL;
+	newpid->next_sibling = NULL;
+	newpid->prev_sibling = NULL;
 
 	//create the exit sempahore
 	if (newpid->exit_semaphore == NULL) {
 		newpid->exit_semaphore = sem_create("exit_semaphore", 0);
 		if (newpid->exit_semaphore == NULL) {
-			panic("pid: sem_create failed\n");
+			kfree(newpid);
+			return NULL;
 		}
 	}
 
@@ -688,74 +1035,142 @@ struct process *pid_alloc(pid_t pid, pid_t p_pid){
 }
 
 /*
- * This function is used to deallocate threads  
+ * This function is used to deallocate threads. Must hold pid_lock.
  */
 void pid_dealloc(pid_t t_pid){
+
+	struct process *p = pid[t_pid];
+
+	//a process should only go away once it has no children left
+	assert(p->children == NULL);
+
+	//take it off its parent's list of children
+	if(p->prev_sibling != NULL){
+		*p->prev_sibling = p->next_sibling;
+		if(p->next_sibling != NULL){
+			p->next_sibling->prev_sibling = p->prev_sibling;
+		}
+	}
 	
 	//destory the semaphores, free the allocated space and set the current pid to NULL
-	sem_destroy(pid[t_pid]->exit_semaphore);
-	kfree(pid[t_pid]);
+	sem_destroy(p->exit_semaphore);
+	kfree(p);
 	pid[t_pid] = NULL;
+	pid_count--;
 }
 
 /*
- * This function is used to return an allocated pid  
+ * This function is used to allocate a pid for a new child of parent.
+ * Must hold pid_lock. Returns an error code; the pid is handed back
+ * in retval.
  */
-int pid_insert(pid_t parent, int32_t *retval){
+int pid_insert(pid_t parent, pid_t *retval){
 
 	//Declare variable
-	int i;
-
-	//look throught the pid array to find the next available slot for the new pid
-	for(i = 0; i < MAX_PIDS; i++){
-		if(pid[i] == NULL){
-			break;
+	struct process *p, *pp;
+	int i, error;
+
+	//keep the table no more than 3/4 full so the search below stays short
+	if((pid_count + 1) * 4 > pid_tablesize * 3){
+		error = pid_grow(pid_tablesize * 2);
+		if(error && pid_count >= pid_tablesize){
+			return EAGAIN;
 		}
 	}
 
-	//check for errors
-	if(i == MAX_PIDS){
-		*retval = -1;
-		return EAGAIN;
+	//next-fit: start looking where the last search left off
+	i = pid_next;
+	while(pid[i] != NULL){
+		i++;
+		if(i >= pid_tablesize){
+			//pid 0 is the kernel, so don't hand it out
+			i = 1;
+		}
 	}
 
 	//call pid allocate to get the pid
-	pid[i] = pid_alloc(i, parent);
+	p = pid_alloc(i, parent);
+	if(p == NULL){
+		return ENOMEM;
+	}
+	pid[i] = p;
+	pid_count++;
+	pid_next = (i + 1 < pid_tablesize) ? i + 1 : 1;
+
+	//put it on the parent's list of children
+	pp = pid_get(parent);
+	if(pp != NULL){
+		p->next_sibling = pp->children;
+		if(p->next_sibling != NULL){
+			p->next_sibling->prev_sibling = &p->next_sibling;
+		}
+		p->prev_sibling = &pp->children;
+		pp->children = p;
+	}
 
-	return i;
+	*retval = i;
+	return 0;
 }
 
 /*
- * This function is used to exit  
+ * This function is used to exit. The exit code is kept until the parent
+ * collects it with waitpid. If there is no parent to do that, the pid is
+ * freed right away. Any children we leave behind are orphaned: the ones
+ * that have already exited are reaped, and the rest will clean up after
+ * themselves when they exit.
  */
 void pid_exit(unsigned exitcode){
 	
 	//declare variables
-	int i;
+	struct process *p, *child;
+	pid_t mypid = curthread->myPid;
 
-	//look throught the pid array to find the spot of the current pid
-	for(i = 0; i < MAX_PIDS; i++){
-		if(pid[i] == NULL){
+	//a thread only exits once
+	if(mypid < 0){
+		return;
+	}
 
+	lock_acquire(pid_lock);
+
+	//the pid is the index into the table
+	p = pid_get(mypid);
+	assert(p != NULL);
+	assert(p->thread_pid == mypid);
+
+	//reap or orphan our children
+	while(p->children != NULL){
+		child = p->children;
+		p->children = child->next_sibling;
+		if(p->children != NULL){
+			p->children->prev_sibling = &p->children;
 		}
-		else if(pid[i]->thread_pid == curthread->myPid){
-			break;
+		child->next_sibling = NULL;
+		child->prev_sibling = NULL;
+		child->parent_pid = -1;
+
+		if(child->exited && child->has_waiters == 0){
+			pid_dealloc(child->thread_pid);
 		}
 	}
 
-	//check if the current thread has others waiting on it if so deallocate
-	switch(pid[i]->has_waiters){
-		case 0:
-		pid_dealloc(i);
-		break;
-		
-		//set the exit code to 1 and decrement the semaphore
-		default:
-		pid[i]->exitcode = exitcode;
-		pid[i]->exited = 1;
-		V(pid[i]->exit_semaphore);
-		break;
+	p->exitcode = exitcode;
+	p->exited = 1;
+	curthread->myPid = -1;
+
+	/*
+	 * Orphans have nobody to wait for them. Neither do children of
+	 * the kernel (pid 0), which never exits and only waits for the
+	 * programs it runs from the menu; keep those only if it's
+	 * already waiting.
+	 */
+	if(p->has_waiters == 0 && p->parent_pid <= 0){
+		pid_dealloc(mypid);
 	}
+	else {
+		V(p->exit_semaphore);
+	}
+
+	lock_release(pid_lock);
 }
 
 /*
@@ -763,40 +1178,52 @@ void pid_exit(unsigned exitcode){
  */
 int pid_wait(pid_t t_pid, int *status, int *retval){
 
+	struct process *p;
+
+	lock_acquire(pid_lock);
+
 	//if the pid doesnt exist then return the pid because it has exited 
-	if(pid[t_pid] == NULL){
+	p = pid_get(t_pid);
+	if(p == NULL){
+		lock_release(pid_lock);
 		*status = 0;
 		*retval = t_pid;
 		return 0;
 	}
 
 	//Check errors
-	if(curthread->myPid != pid[t_pid]->parent_pid){
+	if(curthread->myPid != p->parent_pid){
+		lock_release(pid_lock);
 		*retval=-1;
 		return EINVAL;
 	}
 
 	//This pid has some thread waiting for it to exit
-	pid[t_pid]->has_waiters++;
+	p->has_waiters++;
 
-	//decrement the semaphore
-	P(pid[t_pid]->exit_semaphore);
+	//wait for it to exit without holding the lock
+	lock_release(pid_lock);
+	P(p->exit_semaphore);
+	lock_acquire(pid_lock);
 
-	*status = pid[t_pid]->exitcode;
+	*status = p->exitcode;
 	*retval = t_pid;
 	
-	pid[t_pid]->has_waiters--;
+	p->has_waiters--;
 
-	//if pid has anyone waiting on it then dellocate otherwise increment the exit semaphore
-	switch(pid[t_pid]->has_waiters){
+	//the exit status has been collected, so get rid of the pid
+	//unless someone else is also waiting, in which case pass it on
+	switch(p->has_waiters){
 		case 0:
 		pid_dealloc(t_pid);
 		break;
 		
 		default:
-		V(pid[t_pid]->exit_semaphore);
+		V(p->exit_semaphore);
 		break;
 	}
 
+	lock_release(pid_lock);
+
 	return 0;
 }
@@ -13,6 +13,7 @@
 #include <curthread.h>
 #include <vm.h>
 #include <vfs.h>
+#include <file.h>
 #include <test.h>
 
 /*
@@ -31,6 +32,19 @@ runprogram(char *progname, char **argv, int nargs)
 	int calcu_length, offset;
 	userptr_t new_args[nargs];
 
+	/* Give the program stdin, stdout and stderr on the console */
+	if (curthread->t_filetable == NULL) {
+		curthread->t_filetable = filetable_create();
+		if (curthread->t_filetable == NULL) {
+			return ENOMEM;
+		}
+	}
+	result = filetable_stdio(curthread->t_filetable);
+	if (result) {
+		/* thread_exit destroys curthread->t_filetable */
+		return result;
+	}
+
 	/* Open the file. */
 	result = vfs_open(progname, O_RDONLY, &v);
 	if (result) {
@@ -26,7 +26,7 @@ uiomove(void *ptr, size_t n, struct uio *uio)
 	}
 
 	while (n > 0 && uio->uio_resid > 0) {
-		iov = &uio->uio_iovec;
+		iov = uio->uio_iov;
 		size = iov->iov_len;
 
 		if (size > n) {
@@ -34,6 +34,13 @@ uiomove(void *ptr, size_t n, struct uio *uio)
 		}
 
 		if (size==0) {
+			if (uio->uio_iovcnt > 1) {
+				/* This block is used up; go on to the next. */
+				uio->uio_iov++;
+				uio->uio_iovcnt--;
+				continue;
+			}
+
 			/* 
 			 * This should only happen if you set uio_resid
 			 * incorrectly (to more than the total length of
@@ -115,6 +122,8 @@ mk_kuio(struct uio *uio, void *kbuf, size_t len, off_t pos, enum uio_rw rw)
 {
 	uio->uio_iovec.iov_kbase = kbuf;
 	uio->uio_iovec.iov_len = len;
+	uio->uio_iov = &uio->uio_iovec;
+	uio->uio_iovcnt = 1;
 	uio->uio_offset = pos;
 	uio->uio_resid = len;
 	uio->uio_segflg = UIO_SYSSPACE;
@@ -130,9 +139,31 @@ mk_uuio(struct uio *uio, userptr_t *ubuf, size_t len, off_t pos, enum uio_rw rw)
 {
 	uio->uio_iovec.iov_kbase = ubuf;
 	uio->uio_iovec.iov_len = len;
+	uio->uio_iov = &uio->uio_iovec;
+	uio->uio_iovcnt = 1;
 	uio->uio_offset = pos;
 	uio->uio_resid = len;
 	uio->uio_segflg = UIO_USERSPACE;
 	uio->uio_rw = rw;
 	uio->uio_space = curthread->t_vmspace;
 }
+
+/*
+ * Convenience function to cons up a uio for scatter/gather user I/O.
+ */
+void
+mk_uuiov(struct uio *uio, struct iovec *iov, int iovcnt, off_t pos, enum uio_rw rw)
+{
+	int i;
+
+	uio->uio_iov = iov;
+	uio->uio_iovcnt = iovcnt;
+	uio->uio_offset = pos;
+	uio->uio_resid = 0;
+	for (i=0; i<iovcnt; i++) {
+		uio->uio_resid += iov[i].iov_len;
+	}
+	uio->uio_segflg = UIO_USERSPACE;
+	uio->uio_rw = rw;
+	uio->uio_space = curthread->t_vmspace;
+}
@@ -8,6 +8,8 @@
 #include <machine/spl.h>
 #include <machine/tlb.h>
 #include <synch.h>
+#include <clock.h>
+#include <kern/clockpage.h>
 
 /*
  * Smart MIPS-only "VM system" that is intended to be amazing
@@ -176,13 +178,55 @@ free_kpages(vaddr_t addr)
 	return;
 }
 
+/*
+ * Work out the physical address that VADDR maps to in address space AS.
+ * Every page of a user address space is resident and each region is
+ * physically contiguous, so this is just arithmetic. Besides vm_fault,
+ * this lets the kernel get at another process's memory directly through
+ * kseg0 (see the pipe code).
+ */
 int
-vm_fault(int faulttype, vaddr_t faultaddress)
+vm_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
 {
 	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop, heap_top, heap_base;
+	paddr_t paddr;
+
+	vbase1 = as->as_regions->vaddr;
+	vtop1 = vbase1 + as->as_regions->num_pages * PAGE_SIZE;
+	vbase2 = as->as_regions->next->vaddr;
+	vtop2 = vbase2 + as->as_regions->next->num_pages * PAGE_SIZE;
+	stackbase = USERSTACK - SMARTVM_STACKPAGES * PAGE_SIZE;
+	stacktop = USERSTACK;
+	heap_base = as->heap_start;
+	heap_top = as->heap_end;
+
+	if (vaddr >= vbase1 && vaddr < vtop1) {
+		paddr = (vaddr - vbase1) + as->as_regions->paddr;
+	}
+	else if (vaddr >= vbase2 && vaddr < vtop2) {
+		paddr = (vaddr - vbase2) + as->as_regions->next->paddr;
+	}
+	else if (vaddr >= stackbase && vaddr < stacktop) {
+		paddr = (vaddr - stackbase) + as->as_stackpbase;
+	}
+	else if (vaddr >= heap_base && vaddr < heap_top) {
+		paddr = (vaddr - heap_base) + as->heap->paddr;
+	}
+	else {
+		return EFAULT;
+	}
+
+	*ret = paddr;
+	return 0;
+}
+
+int
+vm_fault(int faulttype, vaddr_t faultaddress)
+{
 	paddr_t paddr = -1;
 	int i = 0;
-	u_int32_t ehi, elo;
+	int result;
+	u_int32_t ehi, elo, dirty;
 	struct addrspace *as;
 	int spl;
 
@@ -195,7 +239,12 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
-		/* We always create pages read-write, so we can't get this */
+		if (faultaddress == CLOCKPAGE_ADDR) {
+			/* Tried to write the clock page */
+			splx(spl);
+			return EFAULT;
+		}
+		/* Other pages are always read-write, so we can't get this */
 		panic("smartvm: got VM_FAULT_READONLY\n");
 	    case VM_FAULT_READ:
 	    case VM_FAULT_WRITE:
@@ -229,29 +278,22 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	assert((as->as_regions->next->paddr & PAGE_FRAME) == as->as_regions->next->paddr);
 	assert((as->as_stackpbase & PAGE_FRAME) == as->as_stackpbase);
 
-	vbase1 = as->as_regions->vaddr;
-	vtop1 = vbase1 + as->as_regions->num_pages * PAGE_SIZE;
-	vbase2 = as->as_regions->next->vaddr;
-	vtop2 = vbase2 + as->as_regions->next->num_pages * PAGE_SIZE;
-	stackbase = USERSTACK - SMARTVM_STACKPAGES * PAGE_SIZE;
-	stacktop = USERSTACK;
-	heap_base = as->heap_start;
-	heap_top = as->heap_end;
-
-	if (faultaddress >= vbase1 && faultaddress < vtop1) {
-		paddr = (faultaddress - vbase1) + as->as_regions->paddr;
-	}
-	else if (faultaddress >= vbase2 && faultaddress < vtop2) {
-		paddr = (faultaddress - vbase2) + as->as_regions->next->paddr;
-	}
-	else if (faultaddress >= stackbase && faultaddress < stacktop) {
-		paddr = (faultaddress - stackbase) + as->as_stackpbase;
+	if (faultaddress == CLOCKPAGE_ADDR && clockpage_paddr() != 0) {
+		/* The clock page is shared by everyone, and read-only */
+		if (faulttype == VM_FAULT_WRITE) {
+			splx(spl);
+			return EFAULT;
+		}
+		paddr = clockpage_paddr();
+		dirty = 0;
 	}
-	else if (faultaddress >= heap_base && faultaddress < heap_top) {
-		paddr = (faultaddress - heap_base) + as->heap->paddr;
-	}else {
-		splx(spl);
-		return EFAULT;
+	else {
+		result = vm_translate(as, faultaddress, &paddr);
+		if (result) {
+			splx(spl);
+			return result;
+		}
+		dirty = TLBLO_DIRTY;
 	}
 
 	/* make sure it's page-aligned */
@@ -263,7 +305,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 			continue;
 		}
 		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
+		elo = paddr | dirty | TLBLO_VALID;
 		DEBUG(DB_VM, "smartvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		TLB_Write(ehi, elo, i);
 		splx(spl);
@@ -0,0 +1,78 @@
+#include <sys/select.h>
+#include <poll.h>
+#include <errno.h>
+
+/*
+ * select, in terms of poll. OPEN_MAX is small enough that building
+ * the pollfd array on the stack is no trouble.
+ */
+
+int
+select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+       struct timeval *timeout)
+{
+	struct pollfd fds[FD_SETSIZE];
+	int n, i, fd, ms, result;
+
+	if (nfds < 0 || nfds > FD_SETSIZE) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	n = 0;
+	for (fd=0; fd<nfds; fd++) {
+		fds[n].fd = fd;
+		fds[n].events = 0;
+		if (readfds != NULL && FD_ISSET(fd, readfds)) {
+			fds[n].events |= POLLIN;
+		}
+		if (writefds != NULL && FD_ISSET(fd, writefds)) {
+			fds[n].events |= POLLOUT;
+		}
+		if (fds[n].events != 0) {
+			n++;
+		}
+	}
+
+	if (timeout == NULL) {
+		ms = -1;
+	}
+	else {
+		ms = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+	}
+
+	result = poll(fds, n, ms);
+	if (result < 0) {
+		return -1;
+	}
+
+	if (readfds != NULL) {
+		FD_ZERO(readfds);
+	}
+	if (writefds != NULL) {
+		FD_ZERO(writefds);
+	}
+	if (exceptfds != NULL) {
+		FD_ZERO(exceptfds);
+	}
+
+	result = 0;
+	for (i=0; i<n; i++) {
+		if (fds[i].revents & POLLNVAL) {
+			errno = EBADF;
+			return -1;
+		}
+		/* Errors and hangups count as ready: the I/O won't block */
+		if ((fds[i].events & POLLIN) &&
+		    (fds[i].revents & (POLLIN|POLLHUP|POLLERR))) {
+			FD_SET(fds[i].fd, readfds);
+			result++;
+		}
+		if ((fds[i].events & POLLOUT) &&
+		    (fds[i].revents & (POLLOUT|POLLHUP|POLLERR))) {
+			FD_SET(fds[i].fd, writefds);
+			result++;
+		}
+	}
+	return result;
+}
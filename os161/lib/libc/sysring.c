@@ -0,0 +1,116 @@
+/*
+ * System call batching ring helpers. See sysring.h.
+ */
+
+#include <sysring.h>
+#include <string.h>
+
+void
+sysring_init(struct sysring *ring)
+{
+	bzero(ring, sizeof(*ring));
+}
+
+struct sysring_sqe *
+sysring_get_sqe(struct sysring *ring)
+{
+	struct sysring_sqe *sqe;
+
+	if (ring->sq_tail - ring->sq_head >= SYSRING_ENTRIES) {
+		return NULL;
+	}
+	sqe = &ring->sq[ring->sq_tail & SYSRING_MASK];
+	bzero(sqe, sizeof(*sqe));
+	ring->sq_tail++;
+	return sqe;
+}
+
+void
+sysring_prep_read(struct sysring_sqe *sqe, int fd, void *buf, size_t len)
+{
+	sqe->op = SYSRING_OP_READ;
+	sqe->fd = fd;
+	sqe->buf = buf;
+	sqe->len = len;
+}
+
+void
+sysring_prep_write(struct sysring_sqe *sqe, int fd, const void *buf,
+		   size_t len)
+{
+	sqe->op = SYSRING_OP_WRITE;
+	sqe->fd = fd;
+	sqe->buf = (void *)buf;
+	sqe->len = len;
+}
+
+void
+sysring_prep_pread(struct sysring_sqe *sqe, int fd, void *buf, size_t len,
+		   off_t off)
+{
+	sqe->op = SYSRING_OP_PREAD;
+	sqe->fd = fd;
+	sqe->buf = buf;
+	sqe->len = len;
+	sqe->off = off;
+}
+
+void
+sysring_prep_pwrite(struct sysring_sqe *sqe, int fd, const void *buf,
+		    size_t len, off_t off)
+{
+	sqe->op = SYSRING_OP_PWRITE;
+	sqe->fd = fd;
+	sqe->buf = (void *)buf;
+	sqe->len = len;
+	sqe->off = off;
+}
+
+void
+sysring_prep_open(struct sysring_sqe *sqe, const char *path, int flags)
+{
+	sqe->op = SYSRING_OP_OPEN;
+	sqe->buf = (void *)path;
+	sqe->flags = flags;
+}
+
+void
+sysring_prep_close(struct sysring_sqe *sqe, int fd)
+{
+	sqe->op = SYSRING_OP_CLOSE;
+	sqe->fd = fd;
+}
+
+int
+sysring_submit(struct sysring *ring)
+{
+	int n, total = 0;
+
+	while (ring->sq_head != ring->sq_tail) {
+		n = sysring_enter(ring);
+		if (n < 0) {
+			return -1;
+		}
+		if (n == 0) {
+			/* Completion queue is full; caller must drain it */
+			break;
+		}
+		total += n;
+	}
+	return total;
+}
+
+struct sysring_cqe *
+sysring_peek_cqe(struct sysring *ring)
+{
+	if (ring->cq_head == ring->cq_tail) {
+		return NULL;
+	}
+	return &ring->cq[ring->cq_head & SYSRING_MASK];
+}
+
+void
+sysring_cqe_seen(struct sysring *ring)
+{
+	ring->cq_head++;
+}
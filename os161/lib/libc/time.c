@@ -1,13 +1,30 @@
 #include <unistd.h>
+#include <kern/clockpage.h>
 
 /*
  * POSIX C function: retrieve time in seconds since the epoch.
- * Uses the OS/161 system call __time, which does the same thing
- * but also returns nanoseconds.
+ *
+ * Rather than trapping into the kernel with __time, read the clock
+ * page the kernel maps into every process and updates on each clock
+ * tick. Seconds never need more resolution than that; use __time for
+ * nanoseconds.
  */
 
 time_t
 time(time_t *t)
 {
-	return __time(t, NULL);
+	const struct clockpage *cp = CLOCKPAGE;
+	u_int32_t seq;
+	time_t secs;
+
+	/* Retry if the kernel was in the middle of an update */
+	do {
+		seq = cp->cp_seq;
+		secs = cp->cp_secs;
+	} while ((seq & 1) || cp->cp_seq != seq);
+
+	if (t != NULL) {
+		*t = secs;
+	}
+	return secs;
 }
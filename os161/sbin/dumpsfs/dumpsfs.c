@@ -26,6 +26,9 @@
 
 #include "disk.h"
 
+/* sp_features from the superblock */
+static u_int32_t features;
+
 static
 u_int32_t
 dumpsb(void)
@@ -38,6 +41,10 @@ dumpsb(void)
 	sp.sp_volname[sizeof(sp.sp_volname)-1] = 0;
 	printf("Volume name: %-40s  %u blocks\n", sp.sp_volname, 
 	       SWAPL(sp.sp_nblocks));
+	features = SWAPL(sp.sp_features);
+	printf("Features: 0x%x%s%s\n", features,
+	       (features & SFS_FEATURE_HASHDIR) ? " (hashed directories)" : "",
+	       (features & SFS_FEATURE_EXTENTS) ? " (extents)" : "");
 
 	return SWAPL(sp.sp_nblocks);
 }
@@ -65,12 +72,40 @@ dodirblock(u_int32_t block)
 	}
 }
 
+/*
+ * Dump the directory blocks under indirect block IDBLOCK, which has
+ * LEVEL levels of indirection. Returns the number of blocks found.
+ */
+static
+u_int32_t
+dumpindirect(u_int32_t idblock, int level)
+{
+	u_int32_t ib[SFS_DBPERIDB];
+	u_int32_t block, nblocks=0;
+	int i;
+
+	diskread(&ib, idblock);
+	for (i=0; i<SFS_DBPERIDB; i++) {
+		block = SWAPL(ib[i]);
+		if (block == 0) {
+			continue;
+		}
+		if (level > 1) {
+			nblocks += dumpindirect(block, level-1);
+		}
+		else {
+			dodirblock(block);
+			nblocks++;
+		}
+	}
+	return nblocks;
+}
+
 static
 void
 dumpdir(u_int32_t ino)
 {
 	struct sfs_inode sfi;
-	u_int32_t ib[SFS_DBPERIDB];
 	int nentries, i;
 	u_int32_t block, nblocks=0;
 
@@ -82,6 +117,25 @@ dumpdir(u_int32_t ino)
 	}
 	printf("Directory %u: %d entries\n", ino, nentries);
 
+	if (features & SFS_FEATURE_EXTENTS) {
+		struct sfs_xinode *sxi = (struct sfs_xinode *)&sfi;
+		u_int32_t j, nx = SWAPL(sxi->sxi_nextents);
+
+		for (i=0; i<(int)nx && i<SFS_NEXTENTS; i++) {
+			block = SWAPL(sxi->sxi_extents[i].sx_start);
+			if (block == 0) {
+				/* hole */
+				continue;
+			}
+			for (j=0; j<SWAPL(sxi->sxi_extents[i].sx_len); j++) {
+				dodirblock(block+j);
+				nblocks++;
+			}
+		}
+		printf("    %u blocks in directory\n", nblocks);
+		return;
+	}
+
 	for (i=0; i<SFS_NDIRECT; i++) {
 		block = SWAPL(sfi.sfi_direct[i]);
 		if (block) {
@@ -90,14 +144,13 @@ dumpdir(u_int32_t ino)
 		}
 	}
 	if (SWAPL(sfi.sfi_indirect)) {
-		diskread(&ib, SWAPL(sfi.sfi_indirect));
-		for (i=0; i<SFS_DBPERIDB; i++) {
-			block = SWAPL(ib[i]);
-			if (block) {
-				dodirblock(block);
-				nblocks++;
-			}
-		}
+		nblocks += dumpindirect(SWAPL(sfi.sfi_indirect), 1);
+	}
+	if (SWAPL(sfi.sfi_dindirect)) {
+		nblocks += dumpindirect(SWAPL(sfi.sfi_dindirect), 2);
+	}
+	if (SWAPL(sfi.sfi_tindirect)) {
+		nblocks += dumpindirect(SWAPL(sfi.sfi_tindirect), 3);
 	}
 	printf("    %u blocks in directory\n", nblocks);
 }
@@ -33,12 +33,13 @@ check(void)
 {
 	assert(sizeof(struct sfs_super)==SFS_BLOCKSIZE);
 	assert(sizeof(struct sfs_inode)==SFS_BLOCKSIZE);
+	assert(sizeof(struct sfs_xinode)==SFS_BLOCKSIZE);
 	assert(SFS_BLOCKSIZE % sizeof(struct sfs_dir) == 0);
 }
 
 static
 void
-writesuper(const char *volname, u_int32_t nblocks)
+writesuper(const char *volname, u_int32_t nblocks, u_int32_t features)
 {
 	struct sfs_super sp;
 
@@ -50,6 +51,7 @@ writesuper(const char *volname, u_int32_t nblocks)
 
 	sp.sp_magic = SWAPL(SFS_MAGIC);
 	sp.sp_nblocks = SWAPL(nblocks);
+	sp.sp_features = SWAPL(features);
 	strcpy(sp.sp_volname, volname);
 
 	diskwrite(&sp, SFS_SB_LOCATION);
@@ -117,14 +119,30 @@ int
 main(int argc, char **argv)
 {
 	u_int32_t size, blocksize;
+	u_int32_t features = 0;
 	char *volname, *s;
 
 #ifdef HOST
 	hostcompat_init(argc, argv);
 #endif
 
+	/* -H: use hashed directories; -E: use extents */
+	while (argc > 3 && argv[1][0]=='-') {
+		if (!strcmp(argv[1], "-H")) {
+			features |= SFS_FEATURE_HASHDIR;
+		}
+		else if (!strcmp(argv[1], "-E")) {
+			features |= SFS_FEATURE_EXTENTS;
+		}
+		else {
+			break;
+		}
+		argc--;
+		argv++;
+	}
+
 	if (argc!=3) {
-		errx(1, "Usage: mksfs device/diskfile volume-name");
+		errx(1, "Usage: mksfs [-H] [-E] device/diskfile volume-name");
 	}
 
 	check();
@@ -155,7 +173,7 @@ main(int argc, char **argv)
 	}
 	size = diskblocks();
 
-	writesuper(volname, size);
+	writesuper(volname, size, features);
 	writerootdir();
 	writebitmap(size);
 
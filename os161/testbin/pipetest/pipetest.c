@@ -0,0 +1,145 @@
+/*
+ * pipetest - test pipe().
+ *
+ * A child process writes a stream of small records followed by one
+ * large block down a pipe, and the parent reads it back and checks it.
+ * The small records exercise the ring buffer and PIPE_BUF atomicity;
+ * the large block is big enough to be lent to the reader directly.
+ * Then check that the reader sees EOF once the writer is gone, and
+ * that writing with no reader fails with EPIPE.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <err.h>
+
+#define NRECORDS  64
+#define BIGSIZE   (48*1024)
+
+static char record[PIPE_BUF];
+static char big[BIGSIZE];
+static char buf[BIGSIZE];
+
+static
+void
+fill(char *p, int len, int seed)
+{
+	int i;
+	for (i=0; i<len; i++) {
+		p[i] = (char)(seed + i*7);
+	}
+}
+
+/* Read exactly LEN bytes, or fail. */
+static
+void
+readall(int fd, char *p, int len)
+{
+	int r, tot = 0;
+
+	while (tot < len) {
+		r = read(fd, p+tot, len-tot);
+		if (r<0) {
+			err(1, "read");
+		}
+		if (r==0) {
+			errx(1, "Unexpected EOF after %d of %d bytes", tot, len);
+		}
+		tot += r;
+	}
+}
+
+static
+void
+writer(int fd)
+{
+	int i, r;
+
+	for (i=0; i<NRECORDS; i++) {
+		fill(record, sizeof(record), i);
+		r = write(fd, record, sizeof(record));
+		if (r != sizeof(record)) {
+			/* Small writes must go in whole */
+			err(1, "write of record %d returned %d", i, r);
+		}
+	}
+
+	fill(big, sizeof(big), NRECORDS);
+	r = write(fd, big, sizeof(big));
+	if (r != sizeof(big)) {
+		err(1, "big write returned %d", r);
+	}
+}
+
+static
+void
+reader(int fd)
+{
+	int i;
+
+	for (i=0; i<NRECORDS; i++) {
+		readall(fd, buf, sizeof(record));
+		fill(record, sizeof(record), i);
+		if (memcmp(buf, record, sizeof(record))) {
+			errx(1, "Record %d is wrong", i);
+		}
+	}
+
+	readall(fd, buf, sizeof(big));
+	fill(big, sizeof(big), NRECORDS);
+	if (memcmp(buf, big, sizeof(big))) {
+		errx(1, "Big block is wrong");
+	}
+
+	if (read(fd, buf, 1) != 0) {
+		errx(1, "Expected EOF");
+	}
+}
+
+int
+main(void)
+{
+	int fds[2];
+	int pid, status;
+
+	if (pipe(fds)) {
+		err(1, "pipe");
+	}
+
+	pid = fork();
+	if (pid<0) {
+		err(1, "fork");
+	}
+	if (pid==0) {
+		close(fds[0]);
+		writer(fds[1]);
+		close(fds[1]);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	reader(fds[0]);
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (status != 0) {
+		errx(1, "Writer exited with status %d", status);
+	}
+	close(fds[0]);
+
+	/* No reader: writes should fail */
+	if (pipe(fds)) {
+		err(1, "pipe");
+	}
+	close(fds[0]);
+	if (write(fds[1], "x", 1) >= 0 || errno != EPIPE) {
+		errx(1, "Write with no reader did not fail with EPIPE");
+	}
+	close(fds[1]);
+
+	printf("Passed pipe test.\n");
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * polltest - test poll() and select().
+ *
+ * Checks that polling an empty pipe times out, that a parent sleeping
+ * in poll on the console and a pipe wakes up when a child writes to
+ * the pipe, that a closed writer shows up as POLLHUP and a closed
+ * reader as POLLERR, and that a bad descriptor gets POLLNVAL. Then
+ * repeats the wakeup test with select().
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+/* Fork a child that sleeps a bit, writes one byte to FD, and exits. */
+static
+int
+spawn_writer(int fd)
+{
+	struct timespec ts;
+	int pid;
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 200000000;
+		nanosleep(&ts, NULL);
+		if (write(fd, "x", 1) != 1) {
+			err(1, "child: write");
+		}
+		_exit(0);
+	}
+	return pid;
+}
+
+static
+void
+reap(int pid)
+{
+	int status;
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+}
+
+int
+main(void)
+{
+	struct pollfd pfd[2];
+	fd_set rset;
+	struct timeval tv;
+	int fds[2], pid, r;
+	char ch;
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+
+	/* Nothing there yet: should time out */
+	pfd[0].fd = fds[0];
+	pfd[0].events = POLLIN;
+	r = poll(pfd, 1, 100);
+	if (r != 0) {
+		errx(1, "poll on empty pipe returned %d, expected 0", r);
+	}
+
+	/* Wait on the console and the pipe; the child should wake us */
+	pid = spawn_writer(fds[1]);
+	pfd[0].fd = STDIN_FILENO;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = fds[0];
+	pfd[1].events = POLLIN;
+	r = poll(pfd, 2, 5000);
+	if (r < 0) {
+		err(1, "poll");
+	}
+	if (r == 0 || !(pfd[1].revents & POLLIN)) {
+		errx(1, "poll did not see data on the pipe");
+	}
+	if (read(fds[0], &ch, 1) != 1 || ch != 'x') {
+		errx(1, "Wrong data on the pipe");
+	}
+	reap(pid);
+
+	/* Same again with select */
+	pid = spawn_writer(fds[1]);
+	FD_ZERO(&rset);
+	FD_SET(fds[0], &rset);
+	tv.tv_sec = 5;
+	tv.tv_usec = 0;
+	r = select(fds[0]+1, &rset, NULL, NULL, &tv);
+	if (r != 1 || !FD_ISSET(fds[0], &rset)) {
+		errx(1, "select returned %d without the pipe ready", r);
+	}
+	if (read(fds[0], &ch, 1) != 1 || ch != 'x') {
+		errx(1, "Wrong data on the pipe");
+	}
+	reap(pid);
+
+	/* The write end is writable */
+	pfd[0].fd = fds[1];
+	pfd[0].events = POLLOUT;
+	if (poll(pfd, 1, 0) != 1 || !(pfd[0].revents & POLLOUT)) {
+		errx(1, "Empty pipe not writable");
+	}
+
+	/* Close the writer: reader sees POLLHUP */
+	close(fds[1]);
+	pfd[0].fd = fds[0];
+	pfd[0].events = POLLIN;
+	if (poll(pfd, 1, 0) != 1 || !(pfd[0].revents & POLLHUP)) {
+		errx(1, "No POLLHUP after writer closed");
+	}
+	close(fds[0]);
+
+	/* Close the reader: writer sees POLLERR */
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+	close(fds[0]);
+	pfd[0].fd = fds[1];
+	pfd[0].events = POLLOUT;
+	if (poll(pfd, 1, 0) != 1 || !(pfd[0].revents & POLLERR)) {
+		errx(1, "No POLLERR after reader closed");
+	}
+	close(fds[1]);
+
+	/* A descriptor that isn't open */
+	pfd[0].fd = fds[1];
+	pfd[0].events = POLLIN;
+	if (poll(pfd, 1, 0) != 1 || pfd[0].revents != POLLNVAL) {
+		errx(1, "No POLLNVAL for closed descriptor");
+	}
+
+	printf("polltest: passed\n");
+	return 0;
+}
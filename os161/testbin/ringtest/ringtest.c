@@ -0,0 +1,126 @@
+/*
+ * ringtest - test batched system calls through sysring_enter().
+ *
+ * Opens a file, writes a series of blocks to it with one batch of
+ * pwrites, reads them back with one batch of preads, and checks the
+ * data and the completions. Then checks that a bad request fails on
+ * its own without stopping the rest of the batch.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <err.h>
+#include <sysring.h>
+
+#define NBLOCKS   16
+#define BLOCKSIZE 512
+#define FILENAME  "ringtest.dat"
+
+static struct sysring ring;
+static char wbuf[NBLOCKS][BLOCKSIZE];
+static char rbuf[NBLOCKS][BLOCKSIZE];
+
+/* Collect one completion and check it against what we expect. */
+static
+void
+expect(u_int32_t tag, int result, int error)
+{
+	struct sysring_cqe *cqe;
+
+	cqe = sysring_peek_cqe(&ring);
+	if (cqe == NULL) {
+		errx(1, "Missing completion for request %u", tag);
+	}
+	if (cqe->user_data != tag) {
+		errx(1, "Completion for request %u, expected %u",
+		     cqe->user_data, tag);
+	}
+	if (cqe->error != error) {
+		errx(1, "Request %u: error %d, expected %d",
+		     tag, cqe->error, error);
+	}
+	if (error == 0 && cqe->result != result) {
+		errx(1, "Request %u: result %d, expected %d",
+		     tag, cqe->result, result);
+	}
+	sysring_cqe_seen(&ring);
+}
+
+int
+main(void)
+{
+	struct sysring_sqe *sqe;
+	char path[] = FILENAME;
+	int fd, i, j, n;
+
+	sysring_init(&ring);
+
+	fd = open(path, O_RDWR|O_CREAT|O_TRUNC);
+	if (fd < 0) {
+		err(1, "%s", path);
+	}
+
+	for (i=0; i<NBLOCKS; i++) {
+		for (j=0; j<BLOCKSIZE; j++) {
+			wbuf[i][j] = (char)(i*31 + j);
+		}
+		sqe = sysring_get_sqe(&ring);
+		if (sqe == NULL) {
+			errx(1, "Submission queue full after %d entries", i);
+		}
+		sysring_prep_pwrite(sqe, fd, wbuf[i], BLOCKSIZE,
+				    (NBLOCKS-1-i)*BLOCKSIZE);
+		sqe->user_data = i;
+	}
+	n = sysring_submit(&ring);
+	if (n != NBLOCKS) {
+		err(1, "sysring_submit (writes) returned %d", n);
+	}
+	for (i=0; i<NBLOCKS; i++) {
+		expect(i, BLOCKSIZE, 0);
+	}
+
+	for (i=0; i<NBLOCKS; i++) {
+		sqe = sysring_get_sqe(&ring);
+		sysring_prep_pread(sqe, fd, rbuf[i], BLOCKSIZE, i*BLOCKSIZE);
+		sqe->user_data = 100+i;
+	}
+	n = sysring_submit(&ring);
+	if (n != NBLOCKS) {
+		err(1, "sysring_submit (reads) returned %d", n);
+	}
+	for (i=0; i<NBLOCKS; i++) {
+		expect(100+i, BLOCKSIZE, 0);
+		if (memcmp(rbuf[i], wbuf[NBLOCKS-1-i], BLOCKSIZE)) {
+			errx(1, "Block %d read back wrong", i);
+		}
+	}
+
+	/* A bad descriptor in the middle of a batch */
+	sqe = sysring_get_sqe(&ring);
+	sysring_prep_pread(sqe, fd, rbuf[0], BLOCKSIZE, 0);
+	sqe->user_data = 200;
+	sqe = sysring_get_sqe(&ring);
+	sysring_prep_read(sqe, -1, rbuf[1], BLOCKSIZE);
+	sqe->user_data = 201;
+	sqe = sysring_get_sqe(&ring);
+	sysring_prep_close(sqe, fd);
+	sqe->user_data = 202;
+	n = sysring_submit(&ring);
+	if (n != 3) {
+		err(1, "sysring_submit (mixed) returned %d", n);
+	}
+	expect(200, BLOCKSIZE, 0);
+	expect(201, -1, EBADF);
+	expect(202, 0, 0);
+
+	if (close(fd) >= 0 || errno != EBADF) {
+		errx(1, "Descriptor still open after batched close");
+	}
+
+	remove(FILENAME);
+	printf("ringtest: passed\n");
+	return 0;
+}